@@ -0,0 +1,90 @@
+#include "arena.h"
+#include <stdlib.h>
+
+/**
+ * The objects are aligned for the most strictly aligned of these types.
+ * */
+typedef union {
+    long double d;
+    long long l;
+    void* p;
+} ArenaAlignment;
+
+struct ArenaChunk {
+    ArenaChunk* next;
+    size_t size;
+    size_t used;
+    ArenaAlignment data[];
+};
+
+void initArena(Arena* arena, size_t chunkSize)
+{
+    arena->chunks = NULL;
+    arena->current = NULL;
+    arena->chunkSize = chunkSize ? chunkSize : DEFAULT_ARENA_CHUNK_SIZE;
+
+    arena->allocations = 0;
+    arena->bytes = 0;
+    arena->chunkAllocations = 0;
+}
+
+void deleteArena(Arena* arena)
+{
+    if(!arena) return;
+
+    while(arena->chunks)
+    {
+        ArenaChunk* next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+
+    arena->current = NULL;
+}
+
+void resetArena(Arena* arena)
+{
+    if(!arena) return;
+
+    for(ArenaChunk* chunk = arena->chunks; chunk; chunk = chunk->next)
+        chunk->used = 0;
+
+    arena->current = arena->chunks;
+    arena->allocations = 0;
+    arena->bytes = 0;
+}
+
+void* arenaAlloc(Arena* arena, size_t size)
+{
+    // Keep every object aligned for any type
+    size_t alignment = sizeof(ArenaAlignment);
+    size = (size + alignment - 1) & ~(alignment - 1);
+
+    // Move on to the next chunk with enough room, reusing the chunks kept by resetArena()
+    while(arena->current && arena->current->used + size > arena->current->size)
+        arena->current = arena->current->next;
+
+    if(!arena->current)
+    {
+        size_t chunkSize = size > arena->chunkSize ? size : arena->chunkSize;
+
+        ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + chunkSize);
+        chunk->size = chunkSize;
+        chunk->used = 0;
+
+        // New chunks go to the front, so that the kept ones are not skipped
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena->current = chunk;
+
+        arena->chunkAllocations++;
+    }
+
+    void* object = (char*)arena->current->data + arena->current->used;
+    arena->current->used += size;
+
+    arena->allocations++;
+    arena->bytes += size;
+
+    return object;
+}
@@ -0,0 +1,55 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+
+/**
+ * Default size of the chunks of an arena, in bytes.
+ * */
+#define DEFAULT_ARENA_CHUNK_SIZE (64 * 1024)
+
+typedef struct ArenaChunk ArenaChunk;
+
+/**
+ * Bump pointer allocator for the objects that live as long as a code
+ * generation. Objects are allocated from large chunks and are never freed
+ * one by one. Instead, resetArena() releases all of them at once, keeping the
+ * chunks for the next code generation.
+ * */
+typedef struct {
+    ArenaChunk* chunks;
+    ArenaChunk* current;
+    size_t chunkSize;
+
+    // Number of allocations and the bytes allocated since the last reset
+    long allocations;
+    long bytes;
+
+    // Number of chunks allocated with malloc(), since initialization
+    long chunkAllocations;
+} Arena;
+
+/**
+ * Initializes the given arena to an empty one. Chunks of chunkSize bytes are
+ * allocated as needed, DEFAULT_ARENA_CHUNK_SIZE if chunkSize is 0.
+ * */
+void initArena(Arena*, size_t chunkSize);
+
+/**
+ * Deallocates the chunks of the given arena.
+ * */
+void deleteArena(Arena*);
+
+/**
+ * Releases every object allocated from the arena. The chunks are kept to be
+ * reused by the following allocations.
+ * */
+void resetArena(Arena*);
+
+/**
+ * Returns size bytes aligned for any object, which are valid until the next
+ * resetArena() or deleteArena() call.
+ * */
+void* arenaAlloc(Arena*, size_t size);
+
+#endif
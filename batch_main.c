@@ -0,0 +1,321 @@
+#define _XOPEN_SOURCE 700
+#include <errno.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "token.h"
+#include "code_generator.h"
+#include "work_pool.h"
+
+/**
+ * Name of the token list files compiled in directory mode, and the names of
+ * the outputs written next to them.
+ * */
+#define LEXER_OUT_NAME "lexer_out.txt"
+#define CG_OUT_NAME    "cg_out.txt"
+#define CG_OUT_C_NAME  "cg_out.c"
+
+/**
+ * A single compilation of the batch.
+ * */
+typedef struct {
+    char* input;
+    char* output;
+
+    // Code generator error code, 0 on success
+    int err;
+
+    // Non-zero if the input or the output could not be opened
+    int ioError;
+} Job;
+
+typedef struct {
+    Job* jobs;
+    int numberOfJobs;
+    int capacity;
+    CodeGeneratorOptions options;
+} Batch;
+
+static void addJob(Batch* batch, const char* input, const char* output)
+{
+    if(batch->numberOfJobs == batch->capacity)
+    {
+        batch->capacity = batch->capacity ? 2 * batch->capacity : 64;
+        batch->jobs = realloc(batch->jobs, batch->capacity * sizeof(Job));
+    }
+
+    batch->jobs[batch->numberOfJobs++] = (Job){ .input = strdup(input), .output = strdup(output), .err = 0, .ioError = 0 };
+}
+
+/**
+ * Returns the given path, prefixed by directory if the path is relative.
+ * The returned string should be freed.
+ * */
+static char* resolvePath(const char* directory, const char* path)
+{
+    if(path[0] == '/' || !directory[0]) return strdup(path);
+
+    char* resolved = malloc(strlen(directory) + strlen(path) + 2);
+    sprintf(resolved, "%s/%s", directory, path);
+
+    return resolved;
+}
+
+/**
+ * Creates the directories on the path to the given file, like mkdir -p.
+ * */
+static void createParentDirectories(const char* file)
+{
+    char* path = strdup(file);
+
+    for(char* p = path + 1; *p; p++)
+    {
+        if(*p != '/') continue;
+
+        *p = '\0';
+        mkdir(path, 0777);
+        *p = '/';
+    }
+
+    free(path);
+}
+
+/**
+ * Adds a job for each line of the manifest. A line is either
+ *
+ *   (lexer_out) (cg_out) ...
+ *
+ * or a line of test/tests.txt, whose first field is "error" or "not_error".
+ * Relative paths are relative to the directory of the manifest.
+ * Returns -1 if the manifest could not be read.
+ * */
+static int readManifest(Batch* batch, const char* manifest)
+{
+    FILE* in = fopen(manifest, "r");
+    if(!in) return -1;
+
+    // Directory of the manifest
+    char* directory = strdup(manifest);
+    char* slash = strrchr(directory, '/');
+    if(slash) *slash = '\0';
+    else      directory[0] = '\0';
+
+    char line[4096];
+    while( fgets(line, sizeof(line), in) )
+    {
+        char* fields[3];
+        int numberOfFields = 0;
+
+        for(char* field = strtok(line, " \t\r\n"); field && numberOfFields < 3; field = strtok(NULL, " \t\r\n"))
+            fields[numberOfFields++] = field;
+
+        // Skip the error/not_error field of the test lists
+        int first = numberOfFields > 0 && (!strcmp(fields[0], "error") || !strcmp(fields[0], "not_error"));
+
+        if(numberOfFields - first < 2) continue;
+
+        char* input = resolvePath(directory, fields[first]);
+        char* output = resolvePath(directory, fields[first + 1]);
+
+        addJob(batch, input, output);
+
+        free(input);
+        free(output);
+    }
+
+    free(directory);
+    fclose(in);
+
+    return 0;
+}
+
+/**
+ * State of the directory walk of readDirectory(). nftw() does not pass a
+ * user argument to its callback.
+ * */
+static struct {
+    Batch* batch;
+    const char* root;
+    const char* outputRoot;
+} walk;
+
+static int visitFile(const char* path, const struct stat* sb, int type, struct FTW* ftw)
+{
+    (void)sb;
+
+    if(type != FTW_F || strcmp(path + ftw->base, LEXER_OUT_NAME)) return 0;
+
+    // The output mirrors the path of the input under the output directory
+    const char* relative = path + strlen(walk.root);
+    const char* name = walk.batch->options.target == TARGET_C ? CG_OUT_C_NAME : CG_OUT_NAME;
+
+    char* output = malloc(strlen(walk.outputRoot) + strlen(relative) + strlen(name) + 1);
+    sprintf(output, "%s%.*s%s", walk.outputRoot, (int)(strlen(relative) - strlen(LEXER_OUT_NAME)), relative, name);
+
+    addJob(walk.batch, path, output);
+    free(output);
+
+    return 0;
+}
+
+/**
+ * Adds a job for each file named lexer_out.txt under the given directory.
+ * Returns -1 if the directory could not be walked.
+ * */
+static int readDirectory(Batch* batch, const char* directory, const char* outputDirectory)
+{
+    walk.batch = batch;
+    walk.root = directory;
+    walk.outputRoot = outputDirectory ? outputDirectory : directory;
+
+    return nftw(directory, visitFile, 16, FTW_PHYS) ? -1 : 0;
+}
+
+static int compareJobs(const void* a, const void* b)
+{
+    return strcmp(((const Job*)a)->input, ((const Job*)b)->input);
+}
+
+/**
+ * Compiles a single token list file, run on the workers of the pool.
+ * */
+static void compile(int index, void* arg)
+{
+    Batch* batch = arg;
+    Job* job = &batch->jobs[index];
+
+    FILE* inp = fopen(job->input, "r");
+    if(!inp)
+    {
+        job->ioError = 1;
+        return;
+    }
+
+    createParentDirectories(job->output);
+
+    FILE* outp = fopen(job->output, "w");
+    if(!outp)
+    {
+        fclose(inp);
+        job->ioError = 1;
+        return;
+    }
+
+    TokenList tokenList = readTokenList(inp);
+
+    job->err = codeGeneratorWithOptions(tokenList, outp, &batch->options);
+    if(job->err) printCGErr(job->err, outp);
+
+    deleteTokenList(&tokenList);
+
+    fclose(inp);
+    fclose(outp);
+}
+
+static void printUsage()
+{
+    fprintf(stderr, "Usage: ./batch_code_generator.out [-t threads] [-c] [-o output_dir] (manifest | directory)\n");
+
+    fprintf(stderr, "\n       threads: The number of worker threads. Defaults to the number of online processors.\n");
+
+    fprintf(stderr, "\n       -c: Output C translation units instead of PM/0 assembly code, see code_generator.out -c.\n");
+
+    fprintf(stderr, "\n       manifest: A file listing a (pl0_lexer_out) (cg_output_file) pair per line. The lines of test/tests.txt are accepted as well. Relative paths are relative to the directory of the manifest.\n");
+
+    fprintf(stderr, "\n       directory: Every file named " LEXER_OUT_NAME " under the directory is compiled to " CG_OUT_NAME " (" CG_OUT_C_NAME " with -c) in the same directory, or in the same relative directory under output_dir if given.\n");
+}
+
+int main(int argc, char **argv)
+{
+    Batch batch = { .jobs = NULL, .numberOfJobs = 0, .capacity = 0, .options = { .target = TARGET_PM0, .symbols = NULL } };
+    const char* outputDirectory = NULL;
+    int numberOfThreads = 0;
+    int argi = 1;
+
+    /**********************************/
+    /* Parse Command Line Arguments */
+    /**********************************/
+    while(argi < argc && argv[argi][0] == '-' && argv[argi][1] != '\0')
+    {
+        if( !strcmp(argv[argi], "-t") && argi + 1 < argc )
+        {
+            numberOfThreads = atoi(argv[argi + 1]);
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-o") && argi + 1 < argc )
+        {
+            outputDirectory = argv[argi + 1];
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-c") )
+        {
+            batch.options.target = TARGET_C;
+            argi++;
+        }
+        else break;
+    }
+
+    if(argi != argc - 1)
+    {
+        printUsage();
+        return -1;
+    }
+
+    const char* source = argv[argi];
+    struct stat sb;
+
+    if( stat(source, &sb) )
+    {
+        fprintf(stderr, "Could not open \"%s\"\n", source);
+        return -1;
+    }
+
+    int err = S_ISDIR(sb.st_mode) ? readDirectory(&batch, source, outputDirectory) : readManifest(&batch, source);
+    if(err)
+    {
+        fprintf(stderr, "Could not read \"%s\": %s\n", source, strerror(errno));
+        return -1;
+    }
+
+    // Compile and report in a deterministic order
+    if(S_ISDIR(sb.st_mode)) qsort(batch.jobs, batch.numberOfJobs, sizeof(Job), compareJobs);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /**********************************/
+    /****  Compile on the workers  ****/
+    /**********************************/
+    runWorkPool(batch.numberOfJobs, numberOfThreads, compile, &batch);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    int succeeded = 0, failed = 0, ioErrors = 0;
+    for(int i = 0; i < batch.numberOfJobs; i++)
+    {
+        Job* job = &batch.jobs[i];
+
+        if(job->ioError)
+        {
+            fprintf(stderr, "Could not compile \"%s\" to \"%s\"\n", job->input, job->output);
+            ioErrors++;
+        }
+        else if(job->err) failed++;
+        else              succeeded++;
+
+        free(job->input);
+        free(job->output);
+    }
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("Compiled %d files in %.3f s: %d succeeded, %d with code generator errors, %d could not be opened\n",
+        batch.numberOfJobs, seconds, succeeded, failed, ioErrors);
+
+    free(batch.jobs);
+
+    return ioErrors ? -1 : 0;
+}
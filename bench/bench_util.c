@@ -0,0 +1,51 @@
+#define _GNU_SOURCE
+#include "bench_util.h"
+#include <time.h>
+
+int countInstructions(VirtualMachine* vm, void* arg)
+{
+    CountingRun* run = arg;
+
+    while(!run->halted && run->executed < run->maxExecuted)
+    {
+        run->halted = stepVirtualMachine(vm, run->code, run->numberOfInstructions, run->vm_inp, run->vm_outp);
+
+        run->executed++;
+        if(vm->SP > run->peakStack) run->peakStack = vm->SP;
+    }
+
+    return VM_HALTED;
+}
+
+long long now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+int compareTimes(const void* a, const void* b)
+{
+    long long x = *(const long long*)a, y = *(const long long*)b;
+
+    return (x > y) - (x < y);
+}
+
+char* readFile(const char* path, size_t* length)
+{
+    FILE* file = fopen(path, "r");
+    if(!file) return NULL;
+
+    char* content = NULL;
+    FILE* copy = open_memstream(&content, length);
+
+    char buffer[4096];
+    size_t n;
+    while( (n = fread(buffer, 1, sizeof(buffer), file)) > 0 ) fwrite(buffer, 1, n, copy);
+
+    fclose(copy);
+    fclose(file);
+
+    return content;
+}
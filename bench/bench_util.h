@@ -0,0 +1,56 @@
+#ifndef __BENCH_UTIL_H__
+#define __BENCH_UTIL_H__
+
+#include <stdio.h>
+#include "../vm/machine.h"
+
+/**
+ * Helpers shared by the benchmarks of the virtual machine, vm_bench.c and
+ * isa_bench.c.
+ * */
+
+/**
+ * State of a run that executes the instructions one at a time with
+ * stepVirtualMachine(), to count them.
+ *
+ * maxExecuted: The run is stopped once this many instructions are executed.
+ * executed   : The number of instructions executed.
+ * peakStack  : The largest SP seen after an instruction.
+ * halted     : Non-zero if the program halted before the limit.
+ * */
+typedef struct {
+    Instruction* code;
+    int numberOfInstructions;
+    FILE* vm_inp;
+    FILE* vm_outp;
+
+    long long maxExecuted;
+    long long executed;
+    int peakStack;
+    int halted;
+} CountingRun;
+
+/**
+ * Executes the CountingRun pointed by arg on vm. Passed to runGuarded(), so
+ * that a stack overflow is reported instead of crashing the benchmark.
+ * Returns VM_HALTED.
+ * */
+int countInstructions(VirtualMachine* vm, void* arg);
+
+/**
+ * Returns the time of the monotonic clock in nanoseconds.
+ * */
+long long now();
+
+/**
+ * Orders two long long times for qsort().
+ * */
+int compareTimes(const void* a, const void* b);
+
+/**
+ * Reads the whole file at the given path and sets length to its length.
+ * Returns NULL if it could not be read. The content is freed by the caller.
+ * */
+char* readFile(const char* path, size_t* length);
+
+#endif
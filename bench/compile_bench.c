@@ -0,0 +1,451 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../token.h"
+#include "../code_generator.h"
+#include "../data.h"
+
+/**
+ * Compile time benchmark of the code generator. Generates synthetic PL/0
+ * token lists of the following shapes and sizes, and measures the stages of
+ * compiling them: reading the token list, parsing and emitting code, and
+ * printing the code. Results are written as JSON.
+ *
+ *   procedures: (size) sibling procedures, each called by the main block.
+ *   nesting   : (size) procedures, each nested in and called by the previous.
+ *   expression: A single assignment of an expression with (size) operands.
+ *   variables : (size) variables in a scope, each assigned in a statement.
+ *
+ * Usage: ./compile_bench.out [-r repeats] [-s shape] [-n size] [-d dump_dir]
+ * */
+
+#define DEFAULT_REPEATS 20
+
+// Large enough for the code of the largest programs generated
+#define BENCH_MAX_CODE_LENGTH (1 << 24)
+
+typedef enum {
+    SHAPE_PROCEDURES, SHAPE_NESTING, SHAPE_EXPRESSION, SHAPE_VARIABLES, NUMBER_OF_SHAPES
+} Shape;
+
+static const char* shapeNames[NUMBER_OF_SHAPES] = {
+    [SHAPE_PROCEDURES] = "procedures",
+    [SHAPE_NESTING]    = "nesting",
+    [SHAPE_EXPRESSION] = "expression",
+    [SHAPE_VARIABLES]  = "variables"
+};
+
+// Default sizes of each shape, 0 terminated
+static const int defaultSizes[NUMBER_OF_SHAPES][4] = {
+    [SHAPE_PROCEDURES] = { 100, 1000, 10000, 0 },
+    [SHAPE_NESTING]    = { 10, 100, 1000, 0 },
+    [SHAPE_EXPRESSION] = { 100, 1000, 10000, 0 },
+    [SHAPE_VARIABLES]  = { 100, 1000, 10000, 0 }
+};
+
+/******************************************************************************/
+/* Generation of token lists **************************************************/
+/******************************************************************************/
+
+static void add(TokenList* tokenList, int id, const char* lexeme)
+{
+    Token token = { .id = id };
+    snprintf(token.lexeme, sizeof(token.lexeme), "%s", lexeme);
+
+    addToken(tokenList, token);
+}
+
+// The lexemes of the symbols used by the generated programs
+static const char* lexemes[] = {
+    [plussym] = "+", [minussym] = "-", [multsym] = "*", [lparentsym] = "(", [rparentsym] = ")",
+    [commasym] = ",", [semicolonsym] = ";", [periodsym] = ".", [becomessym] = ":=",
+    [beginsym] = "begin", [endsym] = "end", [callsym] = "call", [varsym] = "var",
+    [procsym] = "procedure", [writesym] = "write"
+};
+
+static void addSpecial(TokenList* tokenList, int id)
+{
+    add(tokenList, id, lexemes[id]);
+}
+
+static void addName(TokenList* tokenList, char prefix, int i)
+{
+    char name[MAX_LEXEME_LENGTH + 1];
+    snprintf(name, sizeof(name), "%c%d", prefix, i);
+
+    add(tokenList, identsym, name);
+}
+
+static void addNumber(TokenList* tokenList, int value)
+{
+    char number[MAX_LEXEME_LENGTH + 1];
+    snprintf(number, sizeof(number), "%d", value);
+
+    add(tokenList, numbersym, number);
+}
+
+/**
+ * var (prefix)0, ..., (prefix)(n-1);
+ * */
+static void addVariables(TokenList* tokenList, char prefix, int n)
+{
+    addSpecial(tokenList, varsym);
+
+    for(int i = 0; i < n; i++)
+    {
+        if(i) addSpecial(tokenList, commasym);
+        addName(tokenList, prefix, i);
+    }
+
+    addSpecial(tokenList, semicolonsym);
+}
+
+/**
+ * (name) := (name) + 1
+ * */
+static void addIncrement(TokenList* tokenList, char prefix, int i)
+{
+    addName(tokenList, prefix, i);
+    addSpecial(tokenList, becomessym);
+    addName(tokenList, prefix, i);
+    addSpecial(tokenList, plussym);
+    addNumber(tokenList, 1);
+}
+
+static void generateProcedures(TokenList* tokenList, int size)
+{
+    for(int i = 0; i < size; i++)
+    {
+        // procedure p(i); var v0; begin v0 := v0 + 1; write v0 end;
+        addSpecial(tokenList, procsym);
+        addName(tokenList, 'p', i);
+        addSpecial(tokenList, semicolonsym);
+        addVariables(tokenList, 'v', 1);
+        addSpecial(tokenList, beginsym);
+        addIncrement(tokenList, 'v', 0);
+        addSpecial(tokenList, semicolonsym);
+        addSpecial(tokenList, writesym);
+        addName(tokenList, 'v', 0);
+        addSpecial(tokenList, endsym);
+        addSpecial(tokenList, semicolonsym);
+    }
+
+    addSpecial(tokenList, beginsym);
+    for(int i = 0; i < size; i++)
+    {
+        if(i) addSpecial(tokenList, semicolonsym);
+        addSpecial(tokenList, callsym);
+        addName(tokenList, 'p', i);
+    }
+    addSpecial(tokenList, endsym);
+}
+
+static void generateNesting(TokenList* tokenList, int size)
+{
+    // procedure p(i); var v0; ... nested procedures
+    for(int i = 0; i < size; i++)
+    {
+        addSpecial(tokenList, procsym);
+        addName(tokenList, 'p', i);
+        addSpecial(tokenList, semicolonsym);
+        addVariables(tokenList, 'v', 1);
+    }
+
+    // ... begin v0 := v0 + 1; call p(i+1) end;
+    for(int i = size - 1; i >= 0; i--)
+    {
+        addSpecial(tokenList, beginsym);
+        addIncrement(tokenList, 'v', 0);
+
+        if(i + 1 < size)
+        {
+            addSpecial(tokenList, semicolonsym);
+            addSpecial(tokenList, callsym);
+            addName(tokenList, 'p', i + 1);
+        }
+
+        addSpecial(tokenList, endsym);
+        addSpecial(tokenList, semicolonsym);
+    }
+
+    addSpecial(tokenList, callsym);
+    addName(tokenList, 'p', 0);
+}
+
+/**
+ * Operands are variables and numbers, combined by all of the arithmetic
+ * operators, and every eighth operand opens a parenthesis closed by the next.
+ * */
+static void generateExpression(TokenList* tokenList, int size)
+{
+    static const int operators[4] = { plussym, minussym, multsym, plussym };
+
+    addVariables(tokenList, 'v', 8);
+
+    addName(tokenList, 'v', 0);
+    addSpecial(tokenList, becomessym);
+
+    int open = 0;
+    for(int i = 0; i < size; i++)
+    {
+        if(i) addSpecial(tokenList, operators[i % 4]);
+
+        if(i % 8 == 1)
+        {
+            addSpecial(tokenList, lparentsym);
+            open++;
+        }
+
+        if(i % 2) addNumber(tokenList, i % 100 + 1);
+        else      addName(tokenList, 'v', i % 8);
+
+        if(i % 8 == 2 && open)
+        {
+            addSpecial(tokenList, rparentsym);
+            open--;
+        }
+    }
+
+    while(open--) addSpecial(tokenList, rparentsym);
+}
+
+static void generateVariables(TokenList* tokenList, int size)
+{
+    addVariables(tokenList, 'v', size);
+
+    addSpecial(tokenList, beginsym);
+    for(int i = 0; i < size; i++)
+    {
+        // v(i) := v(i-1) + 1
+        if(i) addSpecial(tokenList, semicolonsym);
+
+        addName(tokenList, 'v', i);
+        addSpecial(tokenList, becomessym);
+        addName(tokenList, 'v', i ? i - 1 : size - 1);
+        addSpecial(tokenList, plussym);
+        addNumber(tokenList, 1);
+    }
+    addSpecial(tokenList, endsym);
+}
+
+static TokenList generate(Shape shape, int size)
+{
+    TokenList tokenList;
+    initTokenList(&tokenList);
+
+    switch(shape)
+    {
+        case SHAPE_PROCEDURES: generateProcedures(&tokenList, size); break;
+        case SHAPE_NESTING:    generateNesting(&tokenList, size);    break;
+        case SHAPE_EXPRESSION: generateExpression(&tokenList, size); break;
+        case SHAPE_VARIABLES:  generateVariables(&tokenList, size);  break;
+        default: break;
+    }
+
+    addSpecial(&tokenList, periodsym);
+
+    return tokenList;
+}
+
+/******************************************************************************/
+/* Measurement ****************************************************************/
+/******************************************************************************/
+
+static long long now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static int compareTimes(const void* a, const void* b)
+{
+    long long x = *(const long long*)a, y = *(const long long*)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Minimum and median of the measurements of a stage, in nanoseconds.
+ * */
+typedef struct {
+    long long min;
+    long long median;
+} Timing;
+
+static Timing summarize(long long* times, int n)
+{
+    qsort(times, n, sizeof(long long), compareTimes);
+
+    return (Timing){ .min = times[0], .median = times[n / 2] };
+}
+
+static void printTiming(const char* name, Timing timing, FILE* out)
+{
+    fprintf(out, "\"%s_min_ns\": %lld, \"%s_median_ns\": %lld", name, timing.min, name, timing.median);
+}
+
+/**
+ * Benchmarks a single shape and size, and writes its JSON object.
+ * */
+static void benchmark(Shape shape, int size, int repeats, const char* dumpDirectory, FILE* out)
+{
+    TokenList generated = generate(shape, size);
+
+    // The token list is read from its text, as code_generator.out does
+    char* text = NULL;
+    size_t length = 0;
+    FILE* textp = open_memstream(&text, &length);
+    printTokenList(generated, textp);
+    fclose(textp);
+
+    if(dumpDirectory)
+    {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s_%d.txt", dumpDirectory, shapeNames[shape], size);
+
+        FILE* dump = fopen(path, "w");
+        if(dump)
+        {
+            fwrite(text, 1, length, dump);
+            fclose(dump);
+        }
+        else fprintf(stderr, "Could not open \"%s\"\n", path);
+    }
+
+    long long* readTimes = malloc(repeats * sizeof(long long));
+    long long* parseTimes = malloc(repeats * sizeof(long long));
+    long long* printTimes = malloc(repeats * sizeof(long long));
+
+    CodeGenContext* ctx = createCodeGenContext();
+    CodeGeneratorOptions options = { .target = TARGET_PM0, .symbols = NULL, .maxCodeLength = BENCH_MAX_CODE_LENGTH };
+    FILE* sink = fopen("/dev/null", "w");
+
+    int err = 0, numberOfInstructions = 0;
+
+    for(int r = 0; r < repeats; r++)
+    {
+        long long start = now();
+
+        FILE* inp = fmemopen(text, length, "r");
+        TokenList tokenList = readTokenList(inp);
+        fclose(inp);
+
+        long long read = now();
+
+        err = compileTokenList(ctx, &tokenList, &options);
+        getInstructions(ctx, &numberOfInstructions);
+
+        long long parsed = now();
+
+        if(!err) printGeneratedCode(ctx, sink);
+        fflush(sink);
+
+        long long printed = now();
+
+        readTimes[r] = read - start;
+        parseTimes[r] = parsed - read;
+        printTimes[r] = printed - parsed;
+
+        deleteTokenList(&tokenList);
+    }
+
+    fprintf(out, "    {\"shape\": \"%s\", \"size\": %d, \"tokens\": %d, \"instructions\": %d, \"error\": %d, \"repeats\": %d, ",
+        shapeNames[shape], size, generated.numberOfTokens, numberOfInstructions, err, repeats);
+    printTiming("read", summarize(readTimes, repeats), out);
+    fprintf(out, ", ");
+    printTiming("parse", summarize(parseTimes, repeats), out);
+    fprintf(out, ", ");
+    printTiming("print", summarize(printTimes, repeats), out);
+    fprintf(out, "}");
+
+    fclose(sink);
+    destroyCodeGenContext(ctx);
+
+    free(readTimes);
+    free(parseTimes);
+    free(printTimes);
+    free(text);
+    deleteTokenList(&generated);
+}
+
+static void printUsage()
+{
+    fprintf(stderr, "Usage: ./compile_bench.out [-r repeats] [-s shape] [-n size] [-d dump_dir]\n");
+
+    fprintf(stderr, "\n       repeats: The number of compilations measured per program, %d by default. The minimum and the median are reported.\n", DEFAULT_REPEATS);
+
+    fprintf(stderr, "\n       shape: Only benchmark the programs of the shape: procedures, nesting, expression or variables.\n");
+
+    fprintf(stderr, "\n       size: Only benchmark the programs of the size, instead of the default sizes of each shape.\n");
+
+    fprintf(stderr, "\n       dump_dir: Also write the generated token lists to the directory, named (shape)_(size).txt.\n");
+}
+
+int main(int argc, char** argv)
+{
+    int repeats = DEFAULT_REPEATS;
+    int onlyShape = -1;
+    int onlySize = 0;
+    const char* dumpDirectory = NULL;
+
+    /**********************************/
+    /* Parse Command Line Arguments */
+    /**********************************/
+    for(int argi = 1; argi < argc; argi += 2)
+    {
+        if(argi + 1 >= argc)
+        {
+            printUsage();
+            return -1;
+        }
+
+        if( !strcmp(argv[argi], "-r") ) repeats = atoi(argv[argi + 1]);
+        else if( !strcmp(argv[argi], "-n") ) onlySize = atoi(argv[argi + 1]);
+        else if( !strcmp(argv[argi], "-d") ) dumpDirectory = argv[argi + 1];
+        else if( !strcmp(argv[argi], "-s") )
+        {
+            for(int s = 0; s < NUMBER_OF_SHAPES; s++)
+                if( !strcmp(argv[argi + 1], shapeNames[s]) ) onlyShape = s;
+
+            if(onlyShape < 0)
+            {
+                printUsage();
+                return -1;
+            }
+        }
+        else
+        {
+            printUsage();
+            return -1;
+        }
+    }
+
+    if(repeats < 1) repeats = 1;
+
+    printf("{\n  \"benchmark\": \"compile\",\n  \"results\": [\n");
+
+    int first = 1;
+    for(int s = 0; s < NUMBER_OF_SHAPES; s++)
+    {
+        if(onlyShape >= 0 && s != onlyShape) continue;
+
+        for(int k = 0; onlySize ? k < 1 : defaultSizes[s][k] != 0; k++)
+        {
+            int size = onlySize ? onlySize : defaultSizes[s][k];
+
+            if(!first) printf(",\n");
+            first = 0;
+
+            benchmark(s, size, repeats, dumpDirectory, stdout);
+            fflush(stdout);
+        }
+    }
+
+    printf("\n  ]\n}\n");
+
+    return 0;
+}
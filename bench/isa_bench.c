@@ -0,0 +1,333 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../vm/machine.h"
+#include "../vm/verifier.h"
+#include "../vm/jit.h"
+#include "bench_util.h"
+#include "../token.h"
+#include "../code_generator.h"
+
+/**
+ * Instruction set benchmark. Compiles each program of the test corpus to
+ * classic PM/0 code (TARGET_PM0) and to PM/0 code with the three-address
+ * instructions (TARGET_TAC), runs both on the virtual machine and compares
+ * the number of instructions generated and executed, and the run time.
+ *
+ * The headers of the virtual machine come first, since its data.h defines
+ * the Instruction of both the virtual machine and the code generator, and
+ * the VirtualMachine as well.
+ *
+ * The programs are the not_error cases of a test list in the format of
+ * test/tests.txt, whose paths are relative to the directory of the list.
+ * Each encoding of a program is first run one instruction at a time, to
+ * count the executed instructions and to check its output, up to a limit
+ * of executed instructions. Then, it is timed over a number of runs without
+ * an execution history. Results are written as JSON.
+ *
+ * Usage: ./isa_bench.out [-r repeats] [-l max_executed] [-j] [tests_file=../test/tests.txt]
+ * */
+
+#define DEFAULT_REPEATS 200
+
+#define DEFAULT_MAX_EXECUTED 100000000LL
+
+#define MAX_PATH_LENGTH 4096
+
+/**
+ * The instruction sets compared, in the order they are reported
+ * */
+static const struct {
+    const char* name;
+    CodeGeneratorTarget target;
+} encodings[] = {
+    { "pm0", TARGET_PM0 },
+    { "tac", TARGET_TAC }
+};
+
+#define NUMBER_OF_ENCODINGS ((int)(sizeof(encodings) / sizeof(encodings[0])))
+
+/**
+ * Sets path to the given path of the test list, which is relative to the
+ * directory of the list unless it is absolute.
+ * */
+static void resolvePath(char* path, const char* directory, const char* relative)
+{
+    if(relative[0] == '/') snprintf(path, MAX_PATH_LENGTH, "%s", relative);
+    else snprintf(path, MAX_PATH_LENGTH, "%s/%s", directory, relative);
+}
+
+/**
+ * Returns non-zero if both outputs are the same when white space is ignored,
+ * as the grader compares them with diff -w.
+ * */
+static int sameOutput(const char* a, size_t aLength, const char* b, size_t bLength)
+{
+    size_t i = 0, j = 0;
+
+    while(1)
+    {
+        while(i < aLength && (a[i] == ' ' || a[i] == '\t' || a[i] == '\n' || a[i] == '\r')) i++;
+        while(j < bLength && (b[j] == ' ' || b[j] == '\t' || b[j] == '\n' || b[j] == '\r')) j++;
+
+        if(i == aLength || j == bLength) return i == aLength && j == bLength;
+        if(a[i++] != b[j++]) return 0;
+    }
+}
+
+/**
+ * Options of the benchmark
+ * */
+typedef struct {
+    int repeats;
+    long long maxExecuted;
+    int jit;
+} BenchOptions;
+
+/**
+ * Runs the code of a single encoding of a program and writes its JSON
+ * object. The output of the counting run is returned in output, which the
+ * caller frees. Returns non-zero if the code halted.
+ * */
+static int benchmarkEncoding(Instruction* code, int numberOfInstructions, FILE* vm_inp, const char* expected, size_t expectedLength,
+    const BenchOptions* options, char** output, size_t* outputLength, FILE* out)
+{
+    int verified = !verifyInstructions(code, numberOfInstructions, NULL);
+
+    VirtualMachine* vm = createVirtualMachine(MAX_STACK_HEIGHT);
+
+    // Counting run, which also collects the output
+    FILE* vm_outp = open_memstream(output, outputLength);
+
+    CountingRun run = { code, numberOfInstructions, vm_inp, vm_outp, .maxExecuted = options->maxExecuted };
+
+    int result = VM_HALTED;
+    if(verified)
+    {
+        rewind(vm_inp);
+        resetVirtualMachine(vm);
+        result = runGuarded(vm, countInstructions, &run);
+    }
+    fclose(vm_outp);
+
+    int halted = verified && result == VM_HALTED && run.halted;
+    int correct = halted && expected && sameOutput(*output, *outputLength, expected, expectedLength);
+
+    // Timed runs
+    JitCode* jitCode = halted && options->jit ? compileInstructions(code, numberOfInstructions) : NULL;
+    FILE* sink = fopen("/dev/null", "w");
+    long long* times = malloc(options->repeats * sizeof(long long));
+
+    for(int r = 0; r < options->repeats && halted; r++)
+    {
+        rewind(vm_inp);
+
+        long long start = now();
+
+        if(jitCode)
+        {
+            resetVirtualMachine(vm);
+            runJitCode(jitCode, vm, vm_inp, sink);
+        }
+        else runVirtualMachine(vm, code, numberOfInstructions, NULL, vm_inp, sink, 1, NULL);
+
+        times[r] = now() - start;
+    }
+
+    fprintf(out, "{\"instructions\": %d, \"verified\": %s, \"halted\": %s, \"output_ok\": %s, \"executed\": %lld",
+        numberOfInstructions, verified ? "true" : "false", halted ? "true" : "false", correct ? "true" : "false", run.executed);
+
+    if(halted)
+    {
+        qsort(times, options->repeats, sizeof(long long), compareTimes);
+
+        fprintf(out, ", \"min_ns\": %lld, \"median_ns\": %lld", times[0], times[options->repeats / 2]);
+    }
+
+    fprintf(out, "}");
+
+    free(times);
+    fclose(sink);
+    deleteJitCode(jitCode);
+    deleteVirtualMachine(vm);
+
+    return halted;
+}
+
+/**
+ * Benchmarks every encoding of the program of the given token list, and
+ * writes its JSON object, preceded by a separator unless first is set. first
+ * is cleared once the object is written, nothing is written if the inputs of
+ * the program could not be opened. Returns -1 if they could not be opened, or
+ * if every encoding halted but their outputs are not the same, 0 otherwise.
+ * */
+static int benchmark(const char* directory, const char* lexerOut, const char* vmInp, const char* vmOut,
+    const BenchOptions* options, int* first, FILE* out)
+{
+    char path[MAX_PATH_LENGTH];
+
+    resolvePath(path, directory, lexerOut);
+    FILE* inp = fopen(path, "r");
+    if(!inp)
+    {
+        fprintf(stderr, "Could not open \"%s\"\n", path);
+        return -1;
+    }
+
+    TokenList tokenList = readTokenList(inp);
+    fclose(inp);
+
+    resolvePath(path, directory, vmInp);
+    FILE* vm_inp = fopen(path, "r");
+    if(!vm_inp)
+    {
+        fprintf(stderr, "Could not open \"%s\"\n", path);
+        deleteTokenList(&tokenList);
+        return -1;
+    }
+
+    resolvePath(path, directory, vmOut);
+    size_t expectedLength = 0;
+    char* expected = readFile(path, &expectedLength);
+    if(!expected) fprintf(stderr, "Could not open \"%s\"\n", path);
+
+    if(!*first) fprintf(out, ",\n");
+    *first = 0;
+
+    fprintf(out, "    {\"program\": \"%s\"", lexerOut);
+
+    CodeGenContext* ctx = createCodeGenContext();
+    char* outputs[NUMBER_OF_ENCODINGS] = { NULL };
+    size_t outputLengths[NUMBER_OF_ENCODINGS] = { 0 };
+    int halted = 1;
+    int same = 1;
+
+    for(int e = 0; e < NUMBER_OF_ENCODINGS; e++)
+    {
+        CodeGeneratorOptions cgOptions = { .target = encodings[e].target };
+
+        int err = compileTokenList(ctx, &tokenList, &cgOptions);
+        if(err)
+        {
+            fprintf(out, ", \"error\": %d", err);
+            halted = 0;
+            break;
+        }
+
+        int numberOfInstructions;
+        Instruction* code = getInstructions(ctx, &numberOfInstructions);
+
+        fprintf(out, ", \"%s\": ", encodings[e].name);
+
+        if( !benchmarkEncoding(code, numberOfInstructions, vm_inp, expected, expectedLength, options,
+                &outputs[e], &outputLengths[e], out) ) halted = 0;
+
+        if(!sameOutput(outputs[e], outputLengths[e], outputs[0], outputLengths[0])) same = 0;
+    }
+
+    // The outputs of the programs stopped before halting are not compared
+    if(halted) fprintf(out, ", \"same_output\": %s", same ? "true" : "false");
+    fprintf(out, "}");
+
+    for(int e = 0; e < NUMBER_OF_ENCODINGS; e++) free(outputs[e]);
+
+    destroyCodeGenContext(ctx);
+    deleteTokenList(&tokenList);
+    free(expected);
+    fclose(vm_inp);
+
+    return halted && !same ? -1 : 0;
+}
+
+static void printUsage()
+{
+    fprintf(stderr, "Usage: ./isa_bench.out [-r repeats] [-l max_executed] [-j] [tests_file=../test/tests.txt]\n");
+
+    fprintf(stderr, "\n       repeats: The number of timed runs of each encoding of each program, %d by default. The minimum and the median are reported.\n", DEFAULT_REPEATS);
+
+    fprintf(stderr, "\n       max_executed: The number of executed instructions after which a program is stopped and reported as not halted, %lld by default.\n", DEFAULT_MAX_EXECUTED);
+
+    fprintf(stderr, "\n       -j: Time the instructions translated to native code instead of the interpreter.\n");
+
+    fprintf(stderr, "\n       tests_file: The list of the test cases, in the format of test/tests.txt. Only the not_error cases are run.\n");
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options = { DEFAULT_REPEATS, DEFAULT_MAX_EXECUTED, 0 };
+    const char* testsPath = "../test/tests.txt";
+    int argi = 1;
+
+    // Options precede the test list
+    while(argi < argc && argv[argi][0] == '-')
+    {
+        if( !strcmp(argv[argi], "-r") && argi + 1 < argc )
+        {
+            options.repeats = atoi(argv[argi + 1]);
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-l") && argi + 1 < argc )
+        {
+            options.maxExecuted = atoll(argv[argi + 1]);
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-j") )
+        {
+            options.jit = 1;
+            argi++;
+        }
+        else
+        {
+            printUsage();
+            return -1;
+        }
+    }
+
+    if(argi + 1 < argc)
+    {
+        printUsage();
+        return -1;
+    }
+
+    if(argi < argc) testsPath = argv[argi];
+    if(options.repeats < 1) options.repeats = 1;
+
+    FILE* tests = fopen(testsPath, "r");
+    if(!tests)
+    {
+        fprintf(stderr, "Could not open \"%s\"\n", testsPath);
+        return -1;
+    }
+
+    // The paths of the list are relative to its directory
+    char directory[MAX_PATH_LENGTH / 2];
+    snprintf(directory, sizeof(directory), "%s", testsPath);
+    char* slash = strrchr(directory, '/');
+    if(slash) *slash = '\0';
+    else strcpy(directory, ".");
+
+    printf("{\n  \"benchmark\": \"isa\",\n  \"engine\": \"%s\",\n  \"results\": [\n", options.jit ? "jit" : "interpreter");
+
+    int err = 0;
+    int first = 1;
+    char line[4 * MAX_PATH_LENGTH];
+
+    while( fgets(line, sizeof(line), tests) )
+    {
+        // not_error cg_in cg_out vm_inp vm_out gt_vm_out
+        char kind[32], cgIn[MAX_PATH_LENGTH / 2], cgOut[MAX_PATH_LENGTH / 2], vmInp[MAX_PATH_LENGTH / 2], vmOut[MAX_PATH_LENGTH / 2], gtVmOut[MAX_PATH_LENGTH / 2];
+
+        if( sscanf(line, "%31s %2047s %2047s %2047s %2047s %2047s", kind, cgIn, cgOut, vmInp, vmOut, gtVmOut) != 6 ) continue;
+        if( strcmp(kind, "not_error") ) continue;
+
+        if( benchmark(directory, cgIn, vmInp, gtVmOut, &options, &first, stdout) ) err = -1;
+        fflush(stdout);
+    }
+
+    printf("\n  ]\n}\n");
+
+    fclose(tests);
+
+    return err;
+}
@@ -0,0 +1,228 @@
+#define _GNU_SOURCE
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../vm/machine.h"
+#include "../vm/verifier.h"
+#include "../vm/jit.h"
+#include "bench_util.h"
+
+/**
+ * Execution benchmark of the virtual machine. Runs the workloads listed in
+ * the file workloads.txt of the corpus directory, each of which is a
+ * directory holding:
+ *
+ *   pl0_code.txt: The PL/0 source of the workload, for reference.
+ *   pm0_code.txt: The instructions run by the virtual machine.
+ *   vm_inp.txt  : The input of the SIO instructions.
+ *   vm_out.txt  : The expected output of the SIO instructions.
+ *
+ * Each workload is first run one instruction at a time, to count the executed
+ * instructions, to find the peak stack depth and to check its output. Then,
+ * it is timed over a number of runs, without an execution history, as
+ * vm.out runs it when the history goes to /dev/null. Results are written as
+ * JSON.
+ *
+ * Usage: ./vm_bench.out [-r repeats] [-s stack_height] [-j] [corpus_dir=vm]
+ * */
+
+#define DEFAULT_REPEATS 5
+
+#define MAX_PATH_LENGTH 4096
+
+/**
+ * Benchmarks the workload in the given directory, and writes its JSON object,
+ * preceded by a separator unless first is set. first is cleared once the
+ * object is written, nothing is written if the workload could not be loaded.
+ * Returns 0 if the workload halted with the expected output, -1 otherwise.
+ * */
+static int benchmark(const char* directory, const char* name, int repeats, int stackHeight, int jit, int* first, FILE* out)
+{
+    char path[MAX_PATH_LENGTH];
+
+    snprintf(path, sizeof(path), "%s/%s/pm0_code.txt", directory, name);
+    FILE* inp = fopen(path, "r");
+    if(!inp)
+    {
+        fprintf(stderr, "Could not open \"%s\"\n", path);
+        return -1;
+    }
+
+    Instruction code[MAX_CODE_LENGTH];
+    int numberOfInstructions = readInstructionList(inp, code, MAX_CODE_LENGTH);
+    fclose(inp);
+
+    if(numberOfInstructions <= 0 || verifyInstructions(code, numberOfInstructions, stderr))
+    {
+        fprintf(stderr, "Could not load the instructions of \"%s\"\n", name);
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s/vm_inp.txt", directory, name);
+    FILE* vm_inp = fopen(path, "r");
+    if(!vm_inp)
+    {
+        fprintf(stderr, "Could not open \"%s\"\n", path);
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s/vm_out.txt", directory, name);
+    size_t expectedLength = 0;
+    char* expected = readFile(path, &expectedLength);
+    if(!expected) fprintf(stderr, "Could not open \"%s\"\n", path);
+
+    VirtualMachine* vm = createVirtualMachine(stackHeight);
+
+    // Counting run, which also checks the output
+    char* output = NULL;
+    size_t outputLength = 0;
+    FILE* vm_outp = open_memstream(&output, &outputLength);
+
+    CountingRun run = { code, numberOfInstructions, vm_inp, vm_outp, .maxExecuted = LLONG_MAX };
+
+    resetVirtualMachine(vm);
+    int result = runGuarded(vm, countInstructions, &run);
+    fclose(vm_outp);
+
+    int correct = result == VM_HALTED && expected &&
+                  outputLength == expectedLength && !memcmp(output, expected, outputLength);
+
+    // Timed runs
+    JitCode* jitCode = jit ? compileInstructions(code, numberOfInstructions) : NULL;
+    FILE* sink = fopen("/dev/null", "w");
+    long long* times = malloc(repeats * sizeof(long long));
+
+    for(int r = 0; r < repeats && result == VM_HALTED; r++)
+    {
+        rewind(vm_inp);
+
+        long long start = now();
+
+        if(jitCode)
+        {
+            resetVirtualMachine(vm);
+            result = runJitCode(jitCode, vm, vm_inp, sink);
+        }
+        else result = runVirtualMachine(vm, code, numberOfInstructions, NULL, vm_inp, sink, 1, NULL);
+
+        times[r] = now() - start;
+    }
+
+    if(result == VM_STACK_OVERFLOW)
+    {
+        fprintf(stderr, "\"%s\" needs more than %d stack slots\n", name, stackHeight);
+        correct = 0;
+    }
+
+    if(!*first) fprintf(out, ",\n");
+    *first = 0;
+
+    fprintf(out, "    {\"workload\": \"%s\", \"instructions\": %d, \"executed\": %lld, \"peak_stack\": %d, \"output_ok\": %s",
+        name, numberOfInstructions, run.executed, run.peakStack, correct ? "true" : "false");
+
+    if(result == VM_HALTED)
+    {
+        qsort(times, repeats, sizeof(long long), compareTimes);
+
+        fprintf(out, ", \"repeats\": %d, \"min_ns\": %lld, \"median_ns\": %lld, \"instructions_per_second\": %.0f",
+            repeats, times[0], times[repeats / 2], times[0] ? run.executed * 1e9 / times[0] : 0.0);
+    }
+
+    fprintf(out, "}");
+
+    free(times);
+    fclose(sink);
+    deleteJitCode(jitCode);
+    deleteVirtualMachine(vm);
+
+    free(output);
+    free(expected);
+    fclose(vm_inp);
+
+    return correct ? 0 : -1;
+}
+
+static void printUsage()
+{
+    fprintf(stderr, "Usage: ./vm_bench.out [-r repeats] [-s stack_height] [-j] [corpus_dir=vm]\n");
+
+    fprintf(stderr, "\n       repeats: The number of timed runs of each workload, %d by default. The minimum and the median are reported.\n", DEFAULT_REPEATS);
+
+    fprintf(stderr, "\n       stack_height: The number of slots of the stack of the virtual machine, %d by default.\n", MAX_STACK_HEIGHT);
+
+    fprintf(stderr, "\n       -j: Time the instructions translated to native code instead of the interpreter.\n");
+
+    fprintf(stderr, "\n       corpus_dir: The directory of the workloads, which are listed in its workloads.txt.\n");
+}
+
+int main(int argc, char** argv)
+{
+    int repeats = DEFAULT_REPEATS;
+    int stackHeight = MAX_STACK_HEIGHT;
+    int jit = 0;
+    const char* directory = "vm";
+    int argi = 1;
+
+    // Options precede the corpus directory
+    while(argi < argc && argv[argi][0] == '-')
+    {
+        if( !strcmp(argv[argi], "-r") && argi + 1 < argc )
+        {
+            repeats = atoi(argv[argi + 1]);
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-s") && argi + 1 < argc )
+        {
+            stackHeight = atoi(argv[argi + 1]);
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-j") )
+        {
+            jit = 1;
+            argi++;
+        }
+        else
+        {
+            printUsage();
+            return -1;
+        }
+    }
+
+    if(argi + 1 < argc)
+    {
+        printUsage();
+        return -1;
+    }
+
+    if(argi < argc) directory = argv[argi];
+    if(repeats < 1) repeats = 1;
+
+    char path[MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/workloads.txt", directory);
+
+    FILE* workloads = fopen(path, "r");
+    if(!workloads)
+    {
+        fprintf(stderr, "Could not open \"%s\"\n", path);
+        return -1;
+    }
+
+    printf("{\n  \"benchmark\": \"vm\",\n  \"engine\": \"%s\",\n  \"results\": [\n", jit ? "jit" : "interpreter");
+
+    int err = 0;
+    int first = 1;
+    char name[256];
+
+    while( fscanf(workloads, "%255s", name) == 1 )
+    {
+        if( benchmark(directory, name, repeats, stackHeight, jit, &first, stdout) ) err = -1;
+        fflush(stdout);
+    }
+
+    printf("\n  ]\n}\n");
+
+    fclose(workloads);
+
+    return err;
+}
@@ -0,0 +1,490 @@
+#include "c_backend.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Default stack height of the generated code, same as MAX_STACK_HEIGHT of the
+ * virtual machine.
+ * */
+#define DEFAULT_STACK_HEIGHT 2000
+
+#define REGISTER_COUNT 16
+
+/**
+ * What is known about the code before it is translated.
+ * */
+typedef struct {
+    // Non-zero if the control flow of the code could be followed
+    int wellFormed;
+
+    // Static depth of each instruction, -1 if unreachable
+    int* depths;
+
+    // Non-zero for the instructions that need a label
+    char* labels;
+
+    // Non-zero for the instructions that the program counter is dispatched to
+    char* returnAddresses;
+
+    // Non-zero for the slots of the outermost activation record kept in C variables
+    char* mappedSlots;
+    int numberOfSlots;
+
+    // Non-zero for the registers used by the code
+    char usedRegisters[REGISTER_COUNT];
+
+    int hasReturn;
+} Analysis;
+
+static int isTarget(Instruction* code, int numberOfInstructions, int i)
+{
+    int op = code[i].op;
+
+    int isBranch = op == JMP || op == JPC || op == CAL || op == LCAL || (op >= JEQ && op <= JGE) || (op >= JEQI && op <= JGEI);
+
+    return isBranch && code[i].m >= 0 && code[i].m < numberOfInstructions;
+}
+
+static int usesRegisters(int op, int* count)
+{
+    switch(op)
+    {
+        case LIT: case LOD: case STO: case JPC:
+        case SIO_WRITE: case SIO_READ: case ODD:
+        case JEQI: case JNEI: case JLTI: case JLEI: case JGTI: case JGEI:
+        case LCAL: case LRTN:
+            *count = 1; return 1;
+        case NEG:
+        case JEQ: case JNE: case JLT: case JLE: case JGT: case JGE:
+        case ADDI: case SUBI: case MULI: case DIVI:
+            *count = 2; return 1;
+        case ADD: case SUB: case MUL: case DIV: case MOD:
+        case EQL: case NEQ: case LSS: case LEQ: case GTR: case GEQ:
+            *count = 3; return 1;
+        default:
+            *count = 0; return 0;
+    }
+}
+
+/**
+ * Follows the control flow from the first instruction and from every call
+ * target, recording the stack height and the static depth each instruction
+ * is reached with. Returns 0 if they are inconsistent or an instruction
+ * cannot be translated to C statically (e.g. a register outside of the
+ * register file), 1 otherwise.
+ * */
+static int followControlFlow(Instruction* code, int numberOfInstructions, int* heights, int* depths)
+{
+    // Each instruction pushes at most two states and is expanded only once
+    int* worklist = malloc(3 * 2 * (numberOfInstructions + 1) * sizeof(int));
+    int worklistSize = 0;
+    int consistent = 1;
+
+    for(int i = 0; i < numberOfInstructions; i++)
+        heights[i] = depths[i] = -1;
+
+    #define PUSH(pc, height, depth) do { \
+            worklist[worklistSize++] = (pc); \
+            worklist[worklistSize++] = (height); \
+            worklist[worklistSize++] = (depth); \
+        } while(0)
+
+    PUSH(0, 0, 0);
+
+    while(consistent && worklistSize > 0)
+    {
+        int depth = worklist[--worklistSize];
+        int height = worklist[--worklistSize];
+        int pc = worklist[--worklistSize];
+
+        if(pc < 0 || pc >= numberOfInstructions)
+        {
+            consistent = 0;
+            break;
+        }
+
+        if(heights[pc] >= 0)
+        {
+            consistent = heights[pc] == height && depths[pc] == depth;
+            continue;
+        }
+
+        heights[pc] = height;
+        depths[pc] = depth;
+
+        Instruction ins = code[pc];
+        int count;
+
+        usesRegisters(ins.op, &count);
+        int operands[3] = { ins.r, ins.l, ins.m };
+        for(int k = 0; k < count; k++)
+            if(operands[k] < 0 || operands[k] >= REGISTER_COUNT) consistent = 0;
+
+        if( (ins.op == LOD || ins.op == STO || ins.op == CAL) && (ins.l < 0 || ins.l > depth) )
+            consistent = 0;
+
+        switch(ins.op)
+        {
+            case RTN: case LRTN: case SIO_HALT:
+                break;
+            case INC:
+                if(height + ins.m < 0) consistent = 0;
+                PUSH(pc + 1, height + ins.m, depth);
+                break;
+            case JMP:
+                PUSH(ins.m, height, depth);
+                break;
+            case JPC:
+            case JEQ: case JNE: case JLT: case JLE: case JGT: case JGE:
+            case JEQI: case JNEI: case JLTI: case JLEI: case JGTI: case JGEI:
+                PUSH(pc + 1, height, depth);
+                PUSH(ins.m, height, depth);
+                break;
+            case CAL:
+                PUSH(pc + 1, height, depth);
+                PUSH(ins.m, 0, depth - ins.l + 1);
+                break;
+            case LCAL:
+                PUSH(pc + 1, height, depth);
+                PUSH(ins.m, height, depth);
+                break;
+            default:
+                if(ins.op < LIT || ins.op > JGEI) consistent = 0;
+                PUSH(pc + 1, height, depth);
+                break;
+        }
+    }
+
+    #undef PUSH
+
+    free(worklist);
+
+    return consistent;
+}
+
+static void analyze(Instruction* code, int numberOfInstructions, Analysis* a)
+{
+    int* heights = malloc(numberOfInstructions * sizeof(int));
+
+    memset(a->usedRegisters, 0, sizeof(a->usedRegisters));
+    a->depths = malloc(numberOfInstructions * sizeof(int));
+    a->labels = calloc(numberOfInstructions, 1);
+    a->returnAddresses = calloc(numberOfInstructions + 1, 1);
+    a->wellFormed = numberOfInstructions > 0 && followControlFlow(code, numberOfInstructions, heights, a->depths);
+    a->hasReturn = 0;
+
+    for(int i = 0; i < numberOfInstructions; i++)
+    {
+        int count;
+        usesRegisters(code[i].op, &count);
+
+        int operands[3] = { code[i].r, code[i].l, code[i].m };
+        for(int k = 0; k < count; k++)
+            if(operands[k] >= 0 && operands[k] < REGISTER_COUNT) a->usedRegisters[operands[k]] = 1;
+
+        if(code[i].op == RTN || code[i].op == LRTN) a->hasReturn = 1;
+        if(isTarget(code, numberOfInstructions, i)) a->labels[code[i].m] = 1;
+    }
+
+    for(int i = 0; i < numberOfInstructions; i++)
+    {
+        /**
+         * Without the control flow, anything could be stored as a return
+         * address. Then, every instruction is a possible return address.
+         * */
+        if(a->hasReturn && (!a->wellFormed || code[i].op == CAL || code[i].op == LCAL) && i + 1 < numberOfInstructions)
+            a->returnAddresses[i + 1] = a->labels[i + 1] = 1;
+    }
+    if(!a->wellFormed && a->hasReturn) a->returnAddresses[0] = a->labels[0] = 1;
+
+    /**
+     * A slot of the outermost activation record could be kept in a C variable
+     * if it is never addressed through the stack array. The first
+     * AR_VARIABLE_OFFSET slots are read by RTN, and slots past the height of
+     * the record at a call would overlap the activation record of the callee.
+     * Therefore, only the slots between are mapped. Without a call, which is
+     * when the record is not reserved by INC, every slot addressed is mapped.
+     * */
+    a->numberOfSlots = 0;
+    a->mappedSlots = NULL;
+
+    if(a->wellFormed)
+    {
+        int limit = -1;
+        int calls = 0;
+
+        for(int i = 0; i < numberOfInstructions; i++)
+        {
+            Instruction ins = code[i];
+
+            if(a->depths[i] != 0) continue;
+
+            if(ins.op == CAL && (!calls || heights[i] < limit))
+            {
+                limit = heights[i];
+                calls = 1;
+            }
+            else if( (ins.op == LOD || ins.op == STO) && !calls && ins.m >= limit )
+                limit = ins.m + 1;
+        }
+
+        if(limit > AR_VARIABLE_OFFSET)
+        {
+            a->numberOfSlots = limit;
+            a->mappedSlots = calloc(limit, 1);
+
+            for(int i = 0; i < numberOfInstructions; i++)
+            {
+                Instruction ins = code[i];
+
+                if( (ins.op == LOD || ins.op == STO) && ins.l == a->depths[i]
+                    && ins.m >= AR_VARIABLE_OFFSET && ins.m < limit )
+                    a->mappedSlots[ins.m] = 1;
+            }
+        }
+    }
+
+    free(heights);
+}
+
+static void deleteAnalysis(Analysis* a)
+{
+    free(a->depths);
+    free(a->labels);
+    free(a->returnAddresses);
+    free(a->mappedSlots);
+}
+
+/**
+ * Returns non-zero if the slot M of the activation record L levels down
+ * accessed by the given instruction is kept in a C variable.
+ * */
+static int isMapped(Analysis* a, Instruction ins, int i)
+{
+    return a->wellFormed && ins.l == a->depths[i] && ins.m >= 0 && ins.m < a->numberOfSlots && a->mappedSlots[ins.m];
+}
+
+static void printPrologue(Analysis* a, FILE* out)
+{
+    fprintf(out, "/* Generated from PM/0 code by code_generator.out -c */\n");
+    fprintf(out, "#include <stdio.h>\n#include <stdlib.h>\n\n");
+    fprintf(out, "#ifndef STACK_HEIGHT\n#define STACK_HEIGHT %d\n#endif\n\n", DEFAULT_STACK_HEIGHT);
+    fprintf(out, "static int stack[STACK_HEIGHT];\n\n");
+
+    fprintf(out, "static int base(int bp, int l)\n{\n");
+    fprintf(out, "    while(l-- > 0) bp = stack[bp + 1];\n");
+    fprintf(out, "    return bp;\n}\n\n");
+
+    fprintf(out, "static void readValue(int* r)\n{\n");
+    fprintf(out, "    if(scanf(\"%%d\", r) != 1) return;\n}\n\n");
+
+    fprintf(out, "static void illegal(int op)\n{\n");
+    fprintf(out, "    fflush(stdout);\n");
+    fprintf(out, "    fprintf(stderr, \"VM cannot execute illegal instruction with op code: %%d\\nTerminating VM..\\n\", op);\n");
+    fprintf(out, "    exit(-1);\n}\n\n");
+
+    fprintf(out, "static void overflow(void)\n{\n");
+    fprintf(out, "    fflush(stdout);\n");
+    fprintf(out, "    fprintf(stderr, \"VM stack overflow: more than %%d stack slots are needed\\nTerminating VM..\\n\", STACK_HEIGHT);\n");
+    fprintf(out, "    exit(-1);\n}\n\n");
+
+    fprintf(out, "int main(void)\n{\n");
+    fprintf(out, "    int BP = 1, SP = 0, PC = 0;\n");
+
+    for(int r = 0; r < REGISTER_COUNT; r++)
+        if(a->usedRegisters[r]) fprintf(out, "    int r%d = 0;\n", r);
+
+    for(int m = 0; m < a->numberOfSlots; m++)
+        if(a->mappedSlots[m]) fprintf(out, "    int v%d = 0;\n", m);
+
+    // Not every helper is used by every program
+    fprintf(out, "\n    (void)BP; (void)SP; (void)PC; (void)base; (void)readValue; (void)overflow;\n\n");
+}
+
+static void printJump(int target, int numberOfInstructions, FILE* out)
+{
+    if(target >= 0 && target < numberOfInstructions) fprintf(out, "goto L%d;", target);
+    else                                             fprintf(out, "illegal(0);");
+}
+
+static void printInstruction(Analysis* a, Instruction* code, int numberOfInstructions, int i, FILE* out)
+{
+    Instruction ins = code[i];
+    const char* relop = NULL;
+    const char* arithop = NULL;
+    const char* branchop = NULL;
+    const char* immediateop = NULL;
+    const char* immediatebranchop = NULL;
+
+    switch(ins.op)
+    {
+        case LIT:
+            fprintf(out, "    r%d = %d;\n", ins.r, ins.m);
+            break;
+
+        case RTN:
+            fprintf(out, "    SP = BP - 1; BP = stack[SP + 3]; PC = stack[SP + 4];\n");
+            fprintf(out, "    if(!(PC || BP || SP)) return 0;\n");
+            fprintf(out, "    goto dispatch;\n");
+            break;
+
+        case LOD:
+            if(isMapped(a, ins, i)) fprintf(out, "    r%d = v%d;\n", ins.r, ins.m);
+            else                    fprintf(out, "    r%d = stack[base(BP, %d) + %d];\n", ins.r, ins.l, ins.m);
+            break;
+
+        case STO:
+            if(isMapped(a, ins, i)) fprintf(out, "    v%d = r%d;\n", ins.m, ins.r);
+            else                    fprintf(out, "    stack[base(BP, %d) + %d] = r%d;\n", ins.l, ins.m, ins.r);
+            break;
+
+        case CAL:
+            fprintf(out, "    if(SP + 4 >= STACK_HEIGHT) overflow();\n");
+            fprintf(out, "    stack[SP + 1] = 0; stack[SP + 2] = base(BP, %d); stack[SP + 3] = BP; stack[SP + 4] = %d;\n", ins.l, i + 1);
+            fprintf(out, "    BP = SP + 1;\n    ");
+            printJump(ins.m, numberOfInstructions, out);
+            fprintf(out, "\n");
+            break;
+
+        case LCAL:
+            fprintf(out, "    r%d = %d;\n    ", ins.r, i + 1);
+            printJump(ins.m, numberOfInstructions, out);
+            fprintf(out, "\n");
+            break;
+
+        case LRTN:
+            fprintf(out, "    PC = r%d;\n", ins.r);
+            fprintf(out, "    goto dispatch;\n");
+            break;
+
+        case INC:
+            fprintf(out, "    SP += %d;\n", ins.m);
+            fprintf(out, "    if(SP >= STACK_HEIGHT) overflow();\n");
+            break;
+
+        case JMP:
+            fprintf(out, "    ");
+            printJump(ins.m, numberOfInstructions, out);
+            fprintf(out, "\n");
+            break;
+
+        case JPC:
+            fprintf(out, "    if(r%d == 0) ", ins.r);
+            printJump(ins.m, numberOfInstructions, out);
+            fprintf(out, "\n");
+            break;
+
+        case SIO_WRITE:
+            fprintf(out, "    printf(\"%%d \", r%d);\n", ins.r);
+            break;
+
+        case SIO_READ:
+            fprintf(out, "    readValue(&r%d);\n", ins.r);
+            break;
+
+        case SIO_HALT:
+            fprintf(out, "    return 0;\n");
+            break;
+
+        case NEG:
+            fprintf(out, "    r%d = -r%d;\n", ins.r, ins.l);
+            break;
+
+        case ODD:
+            fprintf(out, "    r%d = r%d %% 2;\n", ins.r, ins.r);
+            break;
+
+        case ADD: arithop = "+"; break;
+        case SUB: arithop = "-"; break;
+        case MUL: arithop = "*"; break;
+        case DIV: arithop = "/"; break;
+        case MOD: arithop = "%"; break;
+
+        case EQL: relop = "=="; break;
+        case NEQ: relop = "!="; break;
+        case LSS: relop = "<";  break;
+        case LEQ: relop = "<="; break;
+        case GTR: relop = ">";  break;
+        case GEQ: relop = ">="; break;
+
+        case JEQ: branchop = "=="; break;
+        case JNE: branchop = "!="; break;
+        case JLT: branchop = "<";  break;
+        case JLE: branchop = "<="; break;
+        case JGT: branchop = ">";  break;
+        case JGE: branchop = ">="; break;
+
+        case ADDI: immediateop = "+"; break;
+        case SUBI: immediateop = "-"; break;
+        case MULI: immediateop = "*"; break;
+        case DIVI: immediateop = "/"; break;
+
+        case JEQI: immediatebranchop = "=="; break;
+        case JNEI: immediatebranchop = "!="; break;
+        case JLTI: immediatebranchop = "<";  break;
+        case JLEI: immediatebranchop = "<="; break;
+        case JGTI: immediatebranchop = ">";  break;
+        case JGEI: immediatebranchop = ">="; break;
+
+        default:
+            fprintf(out, "    illegal(%d);\n", ins.op);
+            break;
+    }
+
+    if(arithop) fprintf(out, "    r%d = r%d %s r%d;\n", ins.r, ins.l, arithop, ins.m);
+    if(relop)   fprintf(out, "    r%d = r%d %s r%d;\n", ins.r, ins.l, relop, ins.m);
+
+    if(immediateop) fprintf(out, "    r%d = r%d %s %d;\n", ins.r, ins.l, immediateop, ins.m);
+
+    if(branchop)
+    {
+        fprintf(out, "    if(r%d %s r%d) ", ins.r, branchop, ins.l);
+        printJump(ins.m, numberOfInstructions, out);
+        fprintf(out, "\n");
+    }
+
+    if(immediatebranchop)
+    {
+        fprintf(out, "    if(r%d %s %d) ", ins.r, immediatebranchop, ins.l);
+        printJump(ins.m, numberOfInstructions, out);
+        fprintf(out, "\n");
+    }
+}
+
+void printCCode(Instruction* code, int numberOfInstructions, FILE* out)
+{
+    Analysis a;
+
+    if(!out) return;
+
+    analyze(code, numberOfInstructions, &a);
+
+    printPrologue(&a, out);
+
+    for(int i = 0; i < numberOfInstructions; i++)
+    {
+        const char* name = code[i].op >= LIT && code[i].op <= LRTN ? opcodeNames[code[i].op] : "???";
+
+        if(a.labels[i]) fprintf(out, "L%d:\n", i);
+        fprintf(out, "    /* %d: %s %d %d %d */\n", i, name, code[i].r, code[i].l, code[i].m);
+
+        printInstruction(&a, code, numberOfInstructions, i, out);
+    }
+
+    // Running off the code memory
+    fprintf(out, "    illegal(0);\n");
+
+    if(a.hasReturn)
+    {
+        fprintf(out, "\ndispatch:\n    switch(PC)\n    {\n");
+
+        for(int i = 0; i < numberOfInstructions; i++)
+            if(a.returnAddresses[i]) fprintf(out, "        case %d: goto L%d;\n", i, i);
+
+        fprintf(out, "        default: illegal(0);\n    }\n");
+    }
+
+    fprintf(out, "\n    return 0;\n}\n");
+
+    deleteAnalysis(&a);
+}
@@ -0,0 +1,27 @@
+#ifndef __C_BACKEND_H__
+#define __C_BACKEND_H__
+
+#include <stdio.h>
+#include "data.h"
+
+/**
+ * Translates the given PM/0 code to a standalone C translation unit and
+ * prints it to the given file. Once compiled with the system compiler, the
+ * resulting executable reads the input of SIO_READ instructions from stdin
+ * and writes the output of SIO_WRITE instructions to stdout in the same
+ * format as the virtual machine does.
+ *
+ * Each instruction becomes a few C statements:
+ *  - Registers of the register file are C variables.
+ *  - Jump and call targets are labels, jumps are gotos.
+ *  - Return addresses are resolved by a switch on the program counter.
+ *  - Stack slots of the outermost activation record are C variables if the
+ *    code is well-formed (consistent stack heights and static depths along
+ *    the control flow, as checked by the verifier of the virtual machine).
+ *    Other stack slots are kept in an array of STACK_HEIGHT slots, which
+ *    defaults to MAX_STACK_HEIGHT of the virtual machine and can be
+ *    overridden by -DSTACK_HEIGHT=n while compiling.
+ * */
+void printCCode(Instruction* code, int numberOfInstructions, FILE* out);
+
+#endif
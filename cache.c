@@ -0,0 +1,297 @@
+#define _GNU_SOURCE
+#include "cache.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FNV_PRIME 1099511628211ULL
+
+#define ENTRY_SUFFIX ".cg"
+
+/**
+ * Counters kept in the file "stats" of the cache directory.
+ * */
+typedef struct {
+    long long hits;
+    long long misses;
+    long long evictions;
+} CacheStats;
+
+/**
+ * Returns the 64-bit FNV-1a hash of the executable of the process, which is
+ * hashed once. Different builds of the code generator could generate
+ * different code for the same tokens.
+ * */
+static unsigned long long hashBuild()
+{
+    static unsigned long long hash = 0;
+
+    if(hash) return hash;
+
+    hash = TOKEN_HASH_BASIS;
+
+    FILE* exe = fopen("/proc/self/exe", "rb");
+    if(exe)
+    {
+        unsigned char buffer[8192];
+        size_t n;
+        while( (n = fread(buffer, 1, sizeof(buffer), exe)) > 0 )
+            for(size_t i = 0; i < n; i++) hash = (hash ^ buffer[i]) * FNV_PRIME;
+
+        fclose(exe);
+    }
+    else
+    {
+        // Without the executable, the time of the build tells builds apart
+        for(const char* c = __DATE__ " " __TIME__; *c; c++) hash = (hash ^ (unsigned char)*c) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+unsigned long long hashTokenList(TokenList* tokenList, const CodeGeneratorOptions* options)
+{
+    unsigned long long hash = hashTokens(tokenList->tokens, tokenList->numberOfTokens, TOKEN_HASH_BASIS);
+
+    // The build, the target and the options that change the code give
+    // different outputs for the same tokens
+    unsigned long long parts[] = {
+        hashBuild(),
+        (unsigned long long)options->target,
+        (unsigned long long)options->disabledPasses,
+        (unsigned long long)options->maxCodeLength
+    };
+
+    for(int i = 0; i < (int)(sizeof(parts) / sizeof(parts[0])); i++)
+        hash = (hash ^ parts[i]) * FNV_PRIME;
+
+    return hash;
+}
+
+void setCacheKey(Cache* cache, TokenList* tokenList, const CodeGeneratorOptions* options)
+{
+    cache->hash = hashTokenList(tokenList, options);
+    cache->numberOfTokens = tokenList->numberOfTokens;
+}
+
+static void getEntryPath(Cache* cache, char* path, size_t size)
+{
+    snprintf(path, size, "%s/%016llx" ENTRY_SUFFIX, cache->directory, cache->hash);
+}
+
+/**
+ * Adds the given counts to the statistics of the cache, under a lock since
+ * the cache is shared by processes. Returns the updated statistics.
+ * */
+static CacheStats countCacheStats(Cache* cache, CacheStats counts)
+{
+    CacheStats stats = { 0, 0, 0 };
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/stats", cache->directory);
+
+    int fd = open(path, O_RDWR | O_CREAT, 0666);
+    if(fd < 0) return stats;
+
+    flock(fd, LOCK_EX);
+
+    FILE* fp = fdopen(fd, "r+");
+    if(!fp)
+    {
+        close(fd);
+        return stats;
+    }
+
+    if( fscanf(fp, "hits %lld misses %lld evictions %lld", &stats.hits, &stats.misses, &stats.evictions) != 3 )
+        stats = (CacheStats){ 0, 0, 0 };
+
+    if(counts.hits || counts.misses || counts.evictions)
+    {
+        stats.hits += counts.hits;
+        stats.misses += counts.misses;
+        stats.evictions += counts.evictions;
+
+        rewind(fp);
+        if( ftruncate(fd, 0) == 0 )
+            fprintf(fp, "hits %lld misses %lld evictions %lld\n", stats.hits, stats.misses, stats.evictions);
+    }
+
+    // Closing the file releases the lock
+    fclose(fp);
+
+    return stats;
+}
+
+int lookupCache(Cache* cache, FILE* out, int* err)
+{
+    // Create the cache directory on first use
+    mkdir(cache->directory, 0777);
+
+    char path[4096];
+    getEntryPath(cache, path, sizeof(path));
+
+    FILE* entry = fopen(path, "r");
+    int numberOfTokens = -1;
+
+    // The number of tokens guards against the rare collisions of the hash
+    if( entry && (fscanf(entry, "cg %d %d", &numberOfTokens, err) != 2 || fgetc(entry) != '\n' || numberOfTokens != cache->numberOfTokens) )
+        numberOfTokens = -1;
+
+    if(numberOfTokens < 0)
+    {
+        if(entry) fclose(entry);
+        countCacheStats(cache, (CacheStats){ .misses = 1 });
+
+        return 0;
+    }
+
+    char buffer[8192];
+    size_t n;
+    while( (n = fread(buffer, 1, sizeof(buffer), entry)) > 0 )
+        fwrite(buffer, 1, n, out);
+
+    fclose(entry);
+
+    // Mark the entry as recently used
+    utimensat(AT_FDCWD, path, NULL, 0);
+
+    countCacheStats(cache, (CacheStats){ .hits = 1 });
+
+    return 1;
+}
+
+typedef struct {
+    char* name;
+    off_t size;
+    struct timespec used;
+} CacheEntry;
+
+static int compareEntries(const void* a, const void* b)
+{
+    const CacheEntry* x = a;
+    const CacheEntry* y = b;
+
+    if(x->used.tv_sec != y->used.tv_sec) return x->used.tv_sec < y->used.tv_sec ? -1 : 1;
+    if(x->used.tv_nsec != y->used.tv_nsec) return x->used.tv_nsec < y->used.tv_nsec ? -1 : 1;
+
+    return strcmp(x->name, y->name);
+}
+
+/**
+ * Lists the entries of the cache directory and sets their total size.
+ * The returned array and the names should be freed.
+ * */
+static CacheEntry* listEntries(Cache* cache, int* numberOfEntries, long long* totalSize)
+{
+    CacheEntry* entries = NULL;
+    int capacity = 0;
+
+    *numberOfEntries = 0;
+    *totalSize = 0;
+
+    DIR* dir = opendir(cache->directory);
+    if(!dir) return NULL;
+
+    struct dirent* dirent;
+    while( (dirent = readdir(dir)) )
+    {
+        size_t length = strlen(dirent->d_name);
+        size_t suffixLength = strlen(ENTRY_SUFFIX);
+
+        if(length <= suffixLength || strcmp(dirent->d_name + length - suffixLength, ENTRY_SUFFIX)) continue;
+
+        struct stat sb;
+        if( fstatat(dirfd(dir), dirent->d_name, &sb, 0) ) continue;
+
+        if(*numberOfEntries == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 64;
+            entries = realloc(entries, capacity * sizeof(CacheEntry));
+        }
+
+        entries[(*numberOfEntries)++] = (CacheEntry){ .name = strdup(dirent->d_name), .size = sb.st_size, .used = sb.st_mtim };
+        *totalSize += sb.st_size;
+    }
+
+    closedir(dir);
+
+    return entries;
+}
+
+/**
+ * Removes the least recently used entries until the cache fits its maximum
+ * size.
+ * */
+static void evictEntries(Cache* cache)
+{
+    int numberOfEntries;
+    long long totalSize;
+    CacheEntry* entries = listEntries(cache, &numberOfEntries, &totalSize);
+
+    long long evictions = 0;
+
+    if(totalSize > cache->maxSize)
+    {
+        qsort(entries, numberOfEntries, sizeof(CacheEntry), compareEntries);
+
+        for(int i = 0; i < numberOfEntries && totalSize > cache->maxSize; i++)
+        {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/%s", cache->directory, entries[i].name);
+
+            // Another process may have evicted the entry already
+            if( unlink(path) == 0 ) evictions++;
+
+            totalSize -= entries[i].size;
+        }
+    }
+
+    for(int i = 0; i < numberOfEntries; i++) free(entries[i].name);
+    free(entries);
+
+    if(evictions) countCacheStats(cache, (CacheStats){ .evictions = evictions });
+}
+
+int storeCache(Cache* cache, int err, const char* output, size_t length)
+{
+    char path[4096], temporaryPath[4096];
+    getEntryPath(cache, path, sizeof(path));
+    snprintf(temporaryPath, sizeof(temporaryPath), "%s/.tmp.%d.%016llx", cache->directory, (int)getpid(), cache->hash);
+
+    FILE* entry = fopen(temporaryPath, "w");
+    if(!entry) return -1;
+
+    fprintf(entry, "cg %d %d\n", cache->numberOfTokens, err);
+    fwrite(output, 1, length, entry);
+
+    if( fclose(entry) || rename(temporaryPath, path) )
+    {
+        unlink(temporaryPath);
+        return -1;
+    }
+
+    evictEntries(cache);
+
+    return 0;
+}
+
+void printCacheStats(Cache* cache, FILE* out)
+{
+    CacheStats stats = countCacheStats(cache, (CacheStats){ 0, 0, 0 });
+
+    int numberOfEntries;
+    long long totalSize;
+    CacheEntry* entries = listEntries(cache, &numberOfEntries, &totalSize);
+
+    for(int i = 0; i < numberOfEntries; i++) free(entries[i].name);
+    free(entries);
+
+    long long lookups = stats.hits + stats.misses;
+
+    fprintf(out, "hits %lld\nmisses %lld\nhit rate %.1f%%\nevictions %lld\nentries %d\nsize %lld / %lld bytes\n",
+        stats.hits, stats.misses, lookups ? 100.0 * stats.hits / lookups : 0.0, stats.evictions,
+        numberOfEntries, totalSize, cache->maxSize);
+}
@@ -0,0 +1,68 @@
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdio.h>
+#include "token.h"
+#include "code_generator.h"
+
+/**
+ * Default maximum size of the entries of a cache directory, in bytes.
+ * */
+#define DEFAULT_CACHE_SIZE (64LL * 1024 * 1024)
+
+/**
+ * Content addressed cache of code generator outputs on disk, shared by the
+ * code generator processes using the same directory.
+ *
+ * Each entry is a file named after the 64-bit hash of the token list, the
+ * executable of the code generator and the options that change its output,
+ * which holds the output written to the cg_output_file and the error
+ * code of the code generation. Entries are written to a temporary file and
+ * renamed, so that a concurrent reader sees either a whole entry or none.
+ *
+ * Hits update the modification time of the entry. When the total size of the
+ * entries exceeds the maximum size, the least recently used entries are
+ * evicted. The hits, misses and evictions are counted in the file "stats" of
+ * the directory.
+ * */
+typedef struct {
+    const char* directory;
+    long long maxSize;
+
+    unsigned long long hash;
+    int numberOfTokens;
+} Cache;
+
+/**
+ * Returns the 64-bit FNV-1a hash of the ids and lexemes of the tokens, see
+ * hashTokens(), the executable of the process, and the target,
+ * disabledPasses and maxCodeLength of the given options.
+ * */
+unsigned long long hashTokenList(TokenList*, const CodeGeneratorOptions*);
+
+/**
+ * Sets the key of the cache to the given token list and options.
+ * */
+void setCacheKey(Cache*, TokenList*, const CodeGeneratorOptions*);
+
+/**
+ * Looks up the entry of the key of the cache. On a hit, writes the cached
+ * output to out, sets err to the cached error code and returns 1. Otherwise,
+ * returns 0.
+ * */
+int lookupCache(Cache*, FILE* out, int* err);
+
+/**
+ * Stores the output of the code generation of the key of the cache, then
+ * evicts entries if the cache exceeds its maximum size.
+ * Returns -1 if the entry could not be written.
+ * */
+int storeCache(Cache*, int err, const char* output, size_t length);
+
+/**
+ * Writes the statistics of the cache: hits, misses, evictions, the number of
+ * entries and their total size.
+ * */
+void printCacheStats(Cache*, FILE*);
+
+#endif
@@ -0,0 +1,264 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * Client of the server mode of the code generator, see server.h for the
+ * protocol. Either compiles a single lexer output, writing the same output
+ * as code_generator.out, or measures the throughput of the server.
+ * */
+
+static double now()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+/**
+ * Reads the whole file to a buffer, which should be freed.
+ * Returns NULL if the file could not be read.
+ * */
+static char* readFile(const char* path, size_t* length)
+{
+    FILE* in = fopen(path, "r");
+    if(!in) return NULL;
+
+    char* buffer = NULL;
+    size_t capacity = 0;
+    *length = 0;
+
+    while(1)
+    {
+        if(*length == capacity)
+        {
+            capacity = capacity ? 2 * capacity : 4096;
+            buffer = realloc(buffer, capacity);
+        }
+
+        size_t n = fread(buffer + *length, 1, capacity - *length, in);
+        if(n == 0) break;
+
+        *length += n;
+    }
+
+    fclose(in);
+
+    return buffer;
+}
+
+/**
+ * Connects to the server. Returns -1 if the connection fails.
+ * */
+static int connectServer(const char* socketPath)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+
+    if(strlen(socketPath) >= sizeof(address.sun_path)) return -1;
+    strcpy(address.sun_path, socketPath);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) return -1;
+
+    if( connect(fd, (struct sockaddr*)&address, sizeof(address)) )
+    {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * Sends a compilation request and reads its response into *output, which is
+ * grown as needed. Returns the code generator error code of the response, or
+ * -1 if the server could not be talked to.
+ * */
+static int compile(FILE* in, FILE* out, const char* input, size_t length, char** output, size_t* outputLength, size_t* capacity)
+{
+    if( fprintf(out, "%zu\n", length) < 0 || fwrite(input, 1, length, out) != length || fflush(out) )
+        return -1;
+
+    int err;
+    if( fscanf(in, "%d %zu", &err, outputLength) != 2 || fgetc(in) != '\n' )
+        return -1;
+
+    if(*outputLength + 1 > *capacity)
+    {
+        *capacity = *outputLength + 1;
+        *output = realloc(*output, *capacity);
+    }
+
+    if( fread(*output, 1, *outputLength, in) != *outputLength )
+        return -1;
+
+    return err;
+}
+
+/**
+ * Runs code_generator.out on the input file count times, to compare the
+ * server with a process per compilation. Returns the elapsed time, or a
+ * negative value if a run fails.
+ * */
+static double runProcesses(const char* codeGenerator, const char* inputPath, int count)
+{
+    double start = now();
+
+    for(int i = 0; i < count; i++)
+    {
+        pid_t pid = fork();
+        if(pid < 0) return -1;
+
+        if(pid == 0)
+        {
+            execl(codeGenerator, codeGenerator, inputPath, "/dev/null", (char*)NULL);
+            _exit(127);
+        }
+
+        int status;
+        if( waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) == 127 )
+            return -1;
+    }
+
+    return now() - start;
+}
+
+static void printUsage()
+{
+    fprintf(stderr, "Usage: ./cg_client.out socket_path (pl0_lexer_out) (cg_output_file)\n");
+    fprintf(stderr, "       ./cg_client.out -b count [-x code_generator] socket_path (pl0_lexer_out)\n");
+
+    fprintf(stderr, "\n       socket_path: The socket of a code generator started with ./code_generator.out -d socket_path.\n");
+
+    fprintf(stderr, "\n       count: Compile the lexer output count times over a single connection and report the compilations per second.\n");
+
+    fprintf(stderr, "\n       code_generator: Also run the given code_generator.out count times on the lexer output, a process per compilation, for comparison.\n");
+}
+
+int main(int argc, char **argv)
+{
+    int count = 0;
+    const char* codeGenerator = NULL;
+    int argi = 1;
+
+    /**********************************/
+    /* Parse Command Line Arguments */
+    /**********************************/
+    while(argi < argc && argv[argi][0] == '-' && argv[argi][1] != '\0')
+    {
+        if( !strcmp(argv[argi], "-b") && argi + 1 < argc )
+        {
+            count = atoi(argv[argi + 1]);
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-x") && argi + 1 < argc )
+        {
+            codeGenerator = argv[argi + 1];
+            argi += 2;
+        }
+        else break;
+    }
+
+    argc -= argi - 1;
+    argv += argi - 1;
+
+    if( (count > 0 && argc != 3) || (count <= 0 && argc != 4) )
+    {
+        printUsage();
+        return -1;
+    }
+
+    size_t length;
+    char* input = readFile(argv[2], &length);
+    if(!input)
+    {
+        fprintf(stderr, "Could not open \"%s\"\n", argv[2]);
+        return -1;
+    }
+
+    int fd = connectServer(argv[1]);
+    if(fd < 0)
+    {
+        fprintf(stderr, "Could not connect to \"%s\": %s\n", argv[1], strerror(errno));
+        free(input);
+        return -1;
+    }
+
+    FILE* in = fdopen(fd, "r");
+    FILE* out = fdopen(dup(fd), "w");
+
+    char* output = NULL;
+    size_t outputLength = 0, capacity = 0;
+    int err = 0;
+
+    if(count <= 0)
+    {
+        /**********************************/
+        /****   Single compilation     ****/
+        /**********************************/
+        err = compile(in, out, input, length, &output, &outputLength, &capacity);
+
+        FILE* outp = err < 0 ? NULL : fopen(argv[3], "w");
+
+        if(err < 0) fprintf(stderr, "Could not compile on \"%s\"\n", argv[1]);
+        else if(!outp) fprintf(stderr, "Could not open \"%s\"\n", argv[3]);
+        else
+        {
+            fwrite(output, 1, outputLength, outp);
+            fclose(outp);
+        }
+
+        if(!outp) err = -1;
+        else      err = 0;
+    }
+    else
+    {
+        /**********************************/
+        /****        Benchmark         ****/
+        /**********************************/
+        double start = now();
+
+        for(int i = 0; i < count && err >= 0; i++)
+            err = compile(in, out, input, length, &output, &outputLength, &capacity);
+
+        double seconds = now() - start;
+
+        if(err < 0) fprintf(stderr, "Could not compile on \"%s\"\n", argv[1]);
+        else
+        {
+            printf("server : %d compilations in %.3f s: %.0f compilations/s, %.1f us/compilation\n",
+                count, seconds, count / seconds, 1e6 * seconds / count);
+
+            if(codeGenerator)
+            {
+                double processSeconds = runProcesses(codeGenerator, argv[2], count);
+
+                if(processSeconds < 0) fprintf(stderr, "Could not run \"%s\"\n", codeGenerator);
+                else
+                {
+                    printf("process: %d compilations in %.3f s: %.0f compilations/s, %.1f us/compilation\n",
+                        count, processSeconds, count / processSeconds, 1e6 * processSeconds / count);
+                    printf("speedup: %.1fx\n", processSeconds / seconds);
+                }
+            }
+
+            err = 0;
+        }
+    }
+
+    free(output);
+    free(input);
+
+    if(in)  fclose(in);
+    if(out) fclose(out);
+
+    return err < 0 ? -1 : 0;
+}
@@ -1,89 +1,239 @@
 #include "token.h"
 #include "data.h"
 #include "symbol.h"
+#include "code_generator.h"
+#include "c_backend.h"
+#include "debug_info.h"
+#include "incremental.h"
+#include "arena.h"
 #include <string.h>
 #include <stdlib.h>
 
 /**
- * This pointer is set when by codeGenerator() func and used by printEmittedCode() func.
- * 
- * You are not required to use it anywhere. The implemented part of the skeleton
- * handles the printing. Instead, you are required to fill the vmCode properly by making
- * use of emit() func.
+ * Register that LCAL stores the return address of a leaf procedure to.
  * */
-FILE* _out;
+#define LEAF_LINK_REGISTER (REGISTER_FILE_REG_COUNT - 1)
 
 /**
- * Token list iterator used by the code generator. It will be set once entered to
- * codeGenerator() and reset before exiting codeGenerator().
+ * A procedure block being generated in incremental code generation. Symbols
+ * at indices below firstSymbol are declared outside of the block.
+ * */
+typedef struct {
+    int firstSymbol;
+    int firstToken;
+    int begin;
+
+    ExternalSymbol* externals;
+    int numberOfExternals;
+} BlockRecording;
+
+/**
+ * State of a code generation. Every function of the code generator takes the
+ * context of the code generation it is a part of, so that several code
+ * generations could be run by several threads at the same time.
+ * */
+struct CodeGenContext {
+    /**
+     * This pointer is set by codeGenerator() func and used by printEmittedCode() func.
+     * 
+     * You are not required to use it anywhere. The implemented part of the skeleton
+     * handles the printing. Instead, you are required to fill the vmCode properly by making
+     * use of emit() func.
+     * */
+    FILE* out;
+
+    /**
+     * Output format and symbol side-file of the code generation.
+     * */
+    CodeGeneratorOptions options;
+
+    /**
+     * Token list iterator used by the code generator. It will be set once entered to
+     * codeGenerator().
+     * 
+     * It is better to use the given helper functions to make use of token list iterator.
+     * */
+    TokenListIterator tokenListIterator;
+
+    /**
+     * Current level. Use this to keep track of the current level for the symbol table entries.
+     * */
+    unsigned int currentLevel;
+
+    /**
+     * Current scope. Use this to keep track of the current scope for the symbol table entries.
+     * NULL means global scope.
+     * */
+    Symbol* currentScope;
+
+    /**
+     * Symbol table.
+     * */
+    SymbolTable symbolTable;
+
+    /**
+     * Procedure ranges and token addresses for the symbol side-file. Only filled
+     * if the side-file is requested.
+     * */
+    DebugInfo debugInfo;
+
+    /**
+     * The array of instructions that the generated(emitted) code will be held.
+     * It has codeCapacity elements, and it is grown by emit() up to
+     * maxCodeLength + 1 elements. The last element is a spare one, which is
+     * overwritten by the instructions emitted past maxCodeLength.
+     * */
+    Instruction* vmCode;
+    int codeCapacity;
+    int maxCodeLength;
+
+    /**
+     * Non-zero if more than maxCodeLength instructions were emitted.
+     * */
+    int codeTooLong;
+
+    /**
+     * The next index in the array of instructions (vmCode) to be filled.
+     * */
+    int nextCodeIndex;
+
+    /**
+     * The id of the register currently being used.
+     * */
+    int currentReg;
+
+    /**
+     * The registers from this one on keep the variables of the block being
+     * generated, so the values of expressions are kept below it.
+     * */
+    int registerLimit;
+
+    /**
+     * The address of the branch emitted by condition(), which is taken when
+     * the condition is false. Its target is patched by the caller.
+     * */
+    int conditionBranch;
+
+    /**
+     * Allocator of the objects that live as long as a code generation, such
+     * as the procedure symbols that are used as the scopes of the symbols of
+     * the symbol table. Reset at the end of each code generation.
+     * */
+    Arena arena;
+
+    /**
+     * Number of allocations of the code generation that are not from the
+     * arena: growths of the code array, the symbol table and the recordings.
+     * */
+    long heapAllocations;
+
+    /**
+     * The blocks of the previous code generation to reuse, NULL if the code
+     * generation is not incremental. The blocks of this code generation are
+     * collected in next, and the blocks being generated in recordings,
+     * innermost last.
+     * */
+    IncrementalState* previous;
+    IncrementalState next;
+    BlockRecording* recordings;
+    int numberOfRecordings;
+};
+
+/**
+ * Emits the instruction whose fields are given as parameters.
+ * Internally, writes the instruction to ctx->vmCode[ctx->nextCodeIndex] and returns the
+ * nextCodeIndex by post-incrementing it.
+ * If maxCodeLength is reached, sets codeTooLong and returns the index of the spare
+ * instruction, so that parsing could go on until the error is reported.
+ * */
+int emit(CodeGenContext* ctx, int OP, int R, int L, int M);
+
+/**
+ * Prints the emitted code array (vmCode) to output file.
  * 
- * It is better to use the given helper functions to make use of token list iterator.
+ * This func is called in the given codeGenerator() function. You are not required
+ * to have another call to this function in your code.
  * */
-TokenListIterator _token_list_it;
+void printEmittedCodes(CodeGenContext* ctx);
 
 /**
- * Current level. Use this to keep track of the current level for the symbol table entries.
+ * Writes the symbol side-file, if one is set in the options.
+ * See printDebugInfo() for its format.
  * */
-unsigned int currentLevel;
+void printSymbolFile(CodeGenContext* ctx);
 
 /**
- * Current scope. Use this to keep track of the current scope for the symbol table entries.
- * NULL means global scope.
+ * Runs the optimization passes that are not disabled in the options on the
+ * generated code, moving the addresses of the symbol side-file along.
  * */
-Symbol* currentScope;
+void optimizeCode(CodeGenContext* ctx);
 
 /**
- * Symbol table.
+ * Runs dead store elimination, unless it is disabled in the options, on the
+ * statement of the block just generated, from begin to its RTN. The slots of
+ * its activation record from firstLocal to numberOfSlots are its variables
+ * that no nested procedure accesses. Moves the addresses of the symbol
+ * side-file along.
  * */
-SymbolTable symbolTable;
+void eliminateBlockDeadStores(CodeGenContext* ctx, int begin, int firstLocal, int numberOfSlots);
 
 /**
- * The array of instructions that the generated(emitted) code will be held.
+ * Allocates the symbol of a procedure, which is the scope of the symbols
+ * declared in the procedure. Since the symbol table moves its symbols as it
+ * grows, scopes are allocated separately from the arena.
  * */
-Instruction vmCode[MAX_CODE_LENGTH];
+Symbol* addScope(CodeGenContext* ctx);
 
 /**
- * The next index in the array of instructions (vmCode) to be filled.
+ * Adds the given symbol to the symbol table, counting the growths of the table.
  * */
-int nextCodeIndex;
+Symbol* declareSymbol(CodeGenContext* ctx, Symbol symbol);
 
 /**
- * The id of the register currently being used.
+ * Looks up the symbol with the given name from the current scope, see
+ * findSymbol(). A variable of an outer block escapes to the activation record
+ * of its block, where nested procedures find it, and is given its slot. In
+ * incremental code generation, records the symbol as an external symbol of
+ * the blocks being generated that it is declared outside of.
  * */
-int currentReg;
+Symbol* lookupSymbol(CodeGenContext* ctx, const char* name);
 
 /**
- * Emits the instruction whose fields are given as parameters.
- * Internally, writes the instruction to vmCode[nextCodeIndex] and returns the
- * nextCodeIndex by post-incrementing it.
- * If MAX_CODE_LENGTH is reached, prints an error message on stderr and exits.
+ * Starts and ends the recording of the block of the given procedure for
+ * incremental code generation.
  * */
-int emit(int OP, int R, int L, int M);
+void beginBlockRecording(CodeGenContext* ctx);
+void endBlockRecording(CodeGenContext* ctx, Symbol* procedure);
 
 /**
- * Prints the emitted code array (vmCode) to output file.
- * 
- * This func is called in the given codeGenerator() function. You are not required
- * to have another call to this function in your code.
+ * If the block of the given procedure, which starts at the current token,
+ * is unchanged since the previous code generation, copies its code and
+ * returns 1. Otherwise, returns 0.
+ * */
+int reuseProcedureBlock(CodeGenContext* ctx, Symbol* procedure);
+
+/**
+ * Converts the code of the given leaf procedure back to a procedure called
+ * with CAL, from its address to its LRTN.
  * */
-void printEmittedCodes();
+void revertLeafProcedure(CodeGenContext* ctx, Symbol* procedure);
 
 /**
  * Returns the current token using the token list iterator.
  * If it is the end of tokens, returns token with id nulsym.
  * */
-Token getCurrentToken();
+Token getCurrentToken(CodeGenContext* ctx);
 
 /**
  * Returns the type of the current token. Returns nulsym if it is the end of tokens.
  * */
-int getCurrentTokenType();
+int getCurrentTokenType(CodeGenContext* ctx);
 
 /**
  * Advances the position of TokenListIterator by incrementing the current token
  * index by one.
  * */
-void nextToken();
+void nextToken(CodeGenContext* ctx);
 
 /**
  * Functions used for non-terminals of the grammar
@@ -91,34 +241,34 @@ void nextToken();
  * rel-op func is removed on purpose. For code generation, it is easier to parse
  * rel-op as a part of condition.
  * */
-int program();
-int block();
-int const_declaration();
-int var_declaration();
-int proc_declaration();
-int statement();
-int condition();
-int expression();
-int term();
-int factor();
+int program(CodeGenContext* ctx);
+int block(CodeGenContext* ctx);
+int const_declaration(CodeGenContext* ctx);
+int var_declaration(CodeGenContext* ctx);
+int proc_declaration(CodeGenContext* ctx);
+int statement(CodeGenContext* ctx);
+int condition(CodeGenContext* ctx);
+int expression(CodeGenContext* ctx);
+int term(CodeGenContext* ctx);
+int factor(CodeGenContext* ctx);
 
 /******************************************************************************/
 /* Definitions of helper functions starts *************************************/
 /******************************************************************************/
 
-Token getCurrentToken()
+Token getCurrentToken(CodeGenContext* ctx)
 {
-    return getCurrentTokenFromIterator(_token_list_it);
+    return getCurrentTokenFromIterator(ctx->tokenListIterator);
 }
 
-int getCurrentTokenType()
+int getCurrentTokenType(CodeGenContext* ctx)
 {
-    return getCurrentToken().id;
+    return getCurrentToken(ctx).id;
 }
 
-void nextToken()
+void nextToken(CodeGenContext* ctx)
 {
-    _token_list_it.currentTokenInd++;
+    ctx->tokenListIterator.currentTokenInd++;
 }
 
 /**
@@ -132,25 +282,100 @@ void printCGErr(int errCode, FILE* fp)
     fprintf(fp, "CODE GENERATOR ERROR[%d]: %s.\n", errCode, codeGeneratorErrMsg[errCode]);
 }
 
-int emit(int OP, int R, int L, int M)
+int emit(CodeGenContext* ctx, int OP, int R, int L, int M)
 {
-    if(nextCodeIndex == MAX_CODE_LENGTH)
+    if(ctx->nextCodeIndex == ctx->maxCodeLength)
     {
-        fprintf(stderr, "MAX_CODE_LENGTH(%d) reached. Emit is unsuccessful: terminating code generator..\n", MAX_CODE_LENGTH);
-        exit(0);
+        ctx->codeTooLong = 1;
+        ctx->vmCode[ctx->maxCodeLength] = (Instruction){ .op = OP, .r = R, .l = L, .m = M};
+
+        return ctx->maxCodeLength;
+    }
+
+    // Grow the code array by doubling, up to the spare instruction
+    if(ctx->nextCodeIndex + 1 >= ctx->codeCapacity)
+    {
+        int capacity = ctx->codeCapacity ? 2 * ctx->codeCapacity : 64;
+        if(capacity > ctx->maxCodeLength + 1) capacity = ctx->maxCodeLength + 1;
+
+        ctx->vmCode = realloc(ctx->vmCode, capacity * sizeof(Instruction));
+        ctx->codeCapacity = capacity;
+        ctx->heapAllocations++;
     }
     
-    vmCode[nextCodeIndex] = (Instruction){ .op = OP, .r = R, .l = L, .m = M};    
+    ctx->vmCode[ctx->nextCodeIndex] = (Instruction){ .op = OP, .r = R, .l = L, .m = M};    
+
+    // Map the current token to the instruction for the symbol side-file
+    if(ctx->options.symbols) addTokenAddress(&ctx->debugInfo, ctx->tokenListIterator.currentTokenInd, ctx->nextCodeIndex);
+
+    return ctx->nextCodeIndex++;
+}
+
+void printSymbolFile(CodeGenContext* ctx)
+{
+    if(!ctx->options.symbols) return;
+
+    printDebugInfo(&ctx->debugInfo, &ctx->symbolTable, ctx->options.symbols);
+}
+
+void optimizeCode(CodeGenContext* ctx)
+{
+    if(!(ctx->options.disabledPasses & PASS_JUMP_THREADING))
+    {
+        long long start = ctx->options.metrics ? readClock() : 0;
+
+        int* addresses = ctx->options.symbols ? malloc((ctx->nextCodeIndex + 1) * sizeof(int)) : NULL;
+
+        ctx->nextCodeIndex = threadJumps(ctx->vmCode, ctx->nextCodeIndex, addresses);
+
+        if(addresses) relocateDebugInfo(&ctx->debugInfo, addresses);
+        free(addresses);
+
+        if(ctx->options.metrics) addStageTime(ctx->options.metrics, "jump_threading", readClock() - start);
+    }
+}
+
+void eliminateBlockDeadStores(CodeGenContext* ctx, int begin, int firstLocal, int numberOfSlots)
+{
+    if( (ctx->options.disabledPasses & PASS_DEAD_STORE_ELIMINATION) || ctx->codeTooLong )
+        return;
+
+    long long start = ctx->options.metrics ? readClock() : 0;
+
+    int* addresses = ctx->options.symbols ? malloc((ctx->nextCodeIndex + 1) * sizeof(int)) : NULL;
+
+    ctx->nextCodeIndex = eliminateDeadStores(ctx->vmCode, begin, ctx->nextCodeIndex, firstLocal, numberOfSlots, addresses);
+
+    if(addresses) relocateDebugInfo(&ctx->debugInfo, addresses);
+    free(addresses);
+
+    if(ctx->options.metrics) addStageTime(ctx->options.metrics, "dead_store_elimination", readClock() - start);
+}
+
+void printGeneratedCode(CodeGenContext* ctx, FILE* out)
+{
+    if(!ctx || !out) return;
 
-    return nextCodeIndex++;
+    long long start = ctx->options.metrics ? readClock() : 0;
+
+    ctx->out = out;
+    printEmittedCodes(ctx);
+
+    if(ctx->options.metrics) addStageTime(ctx->options.metrics, "print", readClock() - start);
 }
 
-void printEmittedCodes()
+void printEmittedCodes(CodeGenContext* ctx)
 {
-    for(int i = 0; i < nextCodeIndex; i++)
+    if(ctx->options.target == TARGET_C)
     {
-        Instruction c = vmCode[i];
-        fprintf(_out, "%d %d %d %d\n", c.op, c.r, c.l, c.m);
+        printCCode(ctx->vmCode, ctx->nextCodeIndex, ctx->out);
+        return;
+    }
+
+    for(int i = 0; i < ctx->nextCodeIndex; i++)
+    {
+        Instruction c = ctx->vmCode[i];
+        fprintf(ctx->out, "%d %d %d %d\n", c.op, c.r, c.l, c.m);
     }
 }
 
@@ -168,69 +393,684 @@ void printEmittedCodes()
  * */
 int codeGenerator(TokenList tokenList, FILE* out)
 {
-    // Set output file pointer
-    _out = out;
+    CodeGeneratorOptions options = { .target = TARGET_PM0, .symbols = NULL };
+
+    return codeGeneratorWithOptions(tokenList, out, &options);
+}
+
+int codeGeneratorWithOptions(TokenList tokenList, FILE* out, const CodeGeneratorOptions* options)
+{
+    CodeGenContext* ctx = createCodeGenContext();
+
+    int err = compileTokenList(ctx, &tokenList, options);
+
+    // Print the emitted codes to the file - if no error occured
+    if(!err) printGeneratedCode(ctx, out);
+
+    destroyCodeGenContext(ctx);
+
+    return err;
+}
+
+CodeGenContext* createCodeGenContext()
+{
+    CodeGenContext* ctx = malloc(sizeof(CodeGenContext));
+
+    ctx->out = NULL;
+    ctx->vmCode = NULL;
+    ctx->codeCapacity = 0;
+    ctx->maxCodeLength = MAX_CODE_LENGTH;
+    ctx->codeTooLong = 0;
+    ctx->nextCodeIndex = 0;
+    ctx->heapAllocations = 0;
+    initArena(&ctx->arena, 0);
+    ctx->previous = NULL;
+    ctx->recordings = NULL;
+    ctx->numberOfRecordings = 0;
+
+    initSymbolTable(&ctx->symbolTable);
+
+    return ctx;
+}
+
+void destroyCodeGenContext(CodeGenContext* ctx)
+{
+    if(!ctx) return;
+
+    deleteSymbolTable(&ctx->symbolTable);
+    deleteArena(&ctx->arena);
+
+    free(ctx->recordings);
+    free(ctx->vmCode);
+    free(ctx);
+}
+
+int compileTokenList(CodeGenContext* ctx, TokenList* tokenList, const CodeGeneratorOptions* options)
+{
+    if(!ctx || !tokenList) return 0;
+
+    // Set options
+    CodeGeneratorOptions defaults = { .target = TARGET_PM0, .symbols = NULL };
+    ctx->options = options ? *options : defaults;
+
+    // Keep the code array of the previous code generation if it is large enough
+    ctx->maxCodeLength = ctx->options.maxCodeLength > 0 ? ctx->options.maxCodeLength : MAX_CODE_LENGTH;
+    if(ctx->codeCapacity > ctx->maxCodeLength + 1)
+    {
+        ctx->vmCode = realloc(ctx->vmCode, (ctx->maxCodeLength + 1) * sizeof(Instruction));
+        ctx->codeCapacity = ctx->maxCodeLength + 1;
+    }
+    ctx->codeTooLong = 0;
+
+    // Allocations are counted per code generation
+    ctx->heapAllocations = 0;
+    long chunkAllocations = ctx->arena.chunkAllocations;
 
     /**
      * Create a token list iterator, which helps to keep track of the current
      * token being parsed.
      * */
-    _token_list_it = getTokenListIterator(&tokenList);
+    ctx->tokenListIterator = getTokenListIterator(tokenList);
 
     // Initialize current level to 0, which is the global level
-    currentLevel = 0;
+    ctx->currentLevel = 0;
 
     // Initialize current scope to NULL, which is the global scope
-    currentScope = NULL;
+    ctx->currentScope = NULL;
 
     // The index on the vmCode array that the next emitted code will be written
-    nextCodeIndex = 0;
+    ctx->nextCodeIndex = 0;
 
     // The id of the register currently being used
-    currentReg = 0;
+    ctx->currentReg = 0;
+    ctx->registerLimit = REGISTER_FILE_REG_COUNT;
 
-    // Initialize symbol table
-    initSymbolTable(&symbolTable);
+    // Empty the symbol table, its memory is reused between code generations
+    clearSymbolTable(&ctx->symbolTable);
+
+    // The code of the symbol side-file is always generated
+    ctx->previous = ctx->options.symbols || ctx->options.target == TARGET_TAC ? NULL : ctx->options.incremental;
+    initIncrementalState(&ctx->next);
+    ctx->numberOfRecordings = 0;
+
+    // Initialize the information for the symbol side-file
+    initDebugInfo(&ctx->debugInfo);
+
+    long long start = ctx->options.metrics ? readClock() : 0;
 
     // Start parsing by parsing program as the grammar suggests.
-    int err = program();
+    int err = program(ctx);
+
+    // The code does not fit in maxCodeLength instructions
+    if(!err && ctx->codeTooLong) err = 20;
+
+    // Report the time of parsing and the counters - if requested
+    if(ctx->options.metrics)
+    {
+        Metrics* metrics = ctx->options.metrics;
 
-    // Print symbol table - if no error occured
-    if(!err)
+        addStageTime(metrics, "parse", readClock() - start);
+
+        metrics->tokensConsumed += ctx->tokenListIterator.currentTokenInd;
+        metrics->symbolsAdded += ctx->symbolTable.numberOfSymbols;
+        metrics->symbolLookups += ctx->symbolTable.lookups;
+        metrics->symbolProbes += ctx->symbolTable.probes;
+        metrics->instructionsEmitted += ctx->nextCodeIndex;
+    }
+
+    // Optimize the code of the whole program - if no error occured
+    int emittedInstructions = ctx->nextCodeIndex;
+    if(!err) optimizeCode(ctx);
+
+    // Print the symbol side-file - if requested and no error occured
+    if(!err) printSymbolFile(ctx);
+
+    // Replace the blocks of the previous code generation - if no error occured
+    if(ctx->previous && !err)
     {
-        // Print the emitted codes to the file
-        printEmittedCodes();
+        ctx->next.stats.numberOfTokens = tokenList->numberOfTokens;
+        ctx->next.stats.numberOfInstructions = emittedInstructions;
+
+        deleteIncrementalState(ctx->previous);
+        *ctx->previous = ctx->next;
     }
+    else deleteIncrementalState(&ctx->next);
+
+    // Recordings are left unfinished by errors
+    ctx->numberOfRecordings = 0;
+    ctx->previous = NULL;
 
-    // Reset output file pointer
-    _out = NULL;
+    // Discard the code of an unsuccessful code generation
+    if(err) ctx->nextCodeIndex = 0;
 
-    // Reset the global TokenListIterator
-    _token_list_it.currentTokenInd = 0;
-    _token_list_it.tokenList = NULL;
+    // Reset the TokenListIterator, the token list is owned by the caller
+    ctx->tokenListIterator.currentTokenInd = 0;
+    ctx->tokenListIterator.tokenList = NULL;
 
-    // Delete symbol table
-    deleteSymbolTable(&symbolTable);
+    // Delete the information for the symbol side-file
+    deleteDebugInfo(&ctx->debugInfo);
+
+    // Report the allocations - if requested
+    if(ctx->options.stats)
+    {
+        ctx->options.stats->arenaAllocations = ctx->arena.allocations;
+        ctx->options.stats->arenaBytes = ctx->arena.bytes;
+        ctx->options.stats->arenaChunkAllocations = ctx->arena.chunkAllocations - chunkAllocations;
+        ctx->options.stats->heapAllocations = ctx->heapAllocations;
+    }
+
+    // Release the objects of the code generation at once, keeping the memory
+    resetArena(&ctx->arena);
 
     // Return err code - which is 0 if parsing was successful
     return err;
 }
 
+Symbol* addScope(CodeGenContext* ctx)
+{
+    return arenaAlloc(&ctx->arena, sizeof(Symbol));
+}
+
+Symbol* declareSymbol(CodeGenContext* ctx, Symbol symbol)
+{
+    int capacity = ctx->symbolTable.capacity;
+    Symbol* added = addSymbol(&ctx->symbolTable, symbol);
+
+    if(ctx->symbolTable.capacity != capacity) ctx->heapAllocations++;
+
+    return added;
+}
+
+/**
+ * Returns the number of variables of the given scope that have their slots.
+ * */
+static int countSlots(CodeGenContext* ctx, Symbol* scope)
+{
+    int slots = 0;
+
+    for(int i = 0; i < ctx->symbolTable.numberOfSymbols; i++)
+    {
+        Symbol* symbol = &ctx->symbolTable.symbols[i];
+
+        if(symbol->type == VAR && symbol->scope == scope && symbol->address) slots++;
+    }
+
+    return slots;
+}
+
+Symbol* lookupSymbol(CodeGenContext* ctx, const char* name)
+{
+    Symbol* symbol = findSymbol(&ctx->symbolTable, ctx->currentScope, name);
+    int index = symbol ? (int)(symbol - ctx->symbolTable.symbols) : -1;
+
+    if(symbol && symbol->type == VAR && symbol->level != ctx->currentLevel && !symbol->address)
+        symbol->address = AR_VARIABLE_OFFSET + countSlots(ctx, symbol->scope);
+
+    for(int i = 0; i < ctx->numberOfRecordings; i++)
+    {
+        BlockRecording* recording = &ctx->recordings[i];
+
+        if(index >= recording->firstSymbol) continue;
+
+        // A name is external to a block only if it is not declared in it, so it has one symbol
+        int k = 0;
+        while(k < recording->numberOfExternals && strcmp(recording->externals[k].name, name)) k++;
+        if(k < recording->numberOfExternals) continue;
+
+        ExternalSymbol external = { .type = -1, .value = 0, .level = 0, .address = 0 };
+        strcpy(external.name, name);
+
+        if(symbol)
+        {
+            external.type = symbol->type;
+            external.value = symbol->type == CONST ? symbol->value : 0;
+            external.level = symbol->level;
+            external.address = symbol->type == CONST ? 0 : symbol->address;
+        }
+
+        // Grow by doubling in the arena, the old array is released with the arena
+        int n = recording->numberOfExternals;
+        if( (n & (n - 1)) == 0 )
+        {
+            ExternalSymbol* externals = arenaAlloc(&ctx->arena, (n ? 2 * n : 1) * sizeof(ExternalSymbol));
+            if(n) memcpy(externals, recording->externals, n * sizeof(ExternalSymbol));
+            recording->externals = externals;
+        }
+
+        recording->externals[recording->numberOfExternals++] = external;
+    }
+
+    return symbol;
+}
+
+void beginBlockRecording(CodeGenContext* ctx)
+{
+    ctx->recordings = realloc(ctx->recordings, (ctx->numberOfRecordings + 1) * sizeof(BlockRecording));
+    ctx->heapAllocations++;
+
+    ctx->recordings[ctx->numberOfRecordings++] = (BlockRecording){
+        .firstSymbol = ctx->symbolTable.numberOfSymbols,
+        .firstToken = ctx->tokenListIterator.currentTokenInd,
+        .begin = ctx->nextCodeIndex,
+        .externals = NULL,
+        .numberOfExternals = 0
+    };
+}
+
+void endBlockRecording(CodeGenContext* ctx, Symbol* procedure)
+{
+    BlockRecording* recording = &ctx->recordings[--ctx->numberOfRecordings];
+    TokenList* tokenList = ctx->tokenListIterator.tokenList;
+    int numberOfTokens = ctx->tokenListIterator.currentTokenInd - recording->firstToken;
+
+    ProcedureBlock block = {
+        .level = procedure->level,
+        .numberOfTokens = numberOfTokens,
+        .hash = hashProcedureBlock(procedure->level, tokenList->tokens + recording->firstToken, numberOfTokens),
+        .begin = recording->begin,
+        .end = ctx->nextCodeIndex,
+        .code = ctx->vmCode + recording->begin,
+        .externals = recording->externals,
+        .numberOfExternals = recording->numberOfExternals
+    };
+    strcpy(block.name, procedure->name);
+
+    addProcedureBlock(&ctx->next, &block);
+    ctx->next.stats.generatedProcedures++;
+}
+
+/**
+ * Returns non-zero if the M of the given opcode is an address of the code,
+ * which moves with the code of its block. The M of LOD and STO is the slot of
+ * a variable in its activation record, which does not.
+ * */
+static int hasAddress(int op)
+{
+    return op == JMP || op == JPC || op == CAL || op == LCAL || (op >= JEQ && op <= JGE) || (op >= JEQI && op <= JGEI);
+}
+
+int reuseProcedureBlock(CodeGenContext* ctx, Symbol* procedure)
+{
+    int firstToken = ctx->tokenListIterator.currentTokenInd;
+    ProcedureBlock* block = findProcedureBlock(ctx->previous, procedure->name, procedure->level, ctx->tokenListIterator.tokenList, firstToken);
+    if(!block) return 0;
+
+    // The external symbols should be the same, except for the addresses of the procedures
+    unsigned* newAddresses = arenaAlloc(&ctx->arena, (block->numberOfExternals + 1) * sizeof(unsigned));
+    int valid = 1;
+
+    for(int i = 0; valid && i < block->numberOfExternals; i++)
+    {
+        ExternalSymbol* external = &block->externals[i];
+        Symbol* symbol = lookupSymbol(ctx, external->name);
+
+        if(!symbol) valid = external->type < 0;
+        else valid = (int)symbol->type == external->type && symbol->level == external->level &&
+                     (symbol->type != CONST || symbol->value == external->value) &&
+                     (symbol->type != VAR || symbol->address == external->address);
+
+        newAddresses[i] = symbol ? symbol->address : 0;
+    }
+
+    if(!valid)
+    {
+        return 0;
+    }
+
+    // The code calls the procedures outside of the block with CAL
+    for(int i = 0; i < block->numberOfExternals; i++)
+    {
+        Symbol* symbol = lookupSymbol(ctx, block->externals[i].name);
+        if(symbol && symbol->type == PROC && symbol->reg >= 0) revertLeafProcedure(ctx, symbol);
+    }
+
+    // Copy the code, moved to the current address
+    int newBegin = ctx->nextCodeIndex;
+
+    for(int k = 0; k < block->end - block->begin; k++)
+    {
+        Instruction c = block->code[k];
+        if(hasAddress(c.op)) c.m = relocateAddress(block, c.m, newBegin, newAddresses);
+
+        emit(ctx, c.op, c.r, c.l, c.m);
+    }
+
+    /**
+     * Keep the block and the blocks of its nested procedures for the next
+     * code generation, moved the same way.
+     * */
+    for(int i = 0; i < ctx->previous->numberOfBlocks; i++)
+    {
+        ProcedureBlock* nested = &ctx->previous->blocks[i];
+        if(nested->begin < block->begin || nested->begin >= block->end) continue;
+
+        ProcedureBlock* copy = addProcedureBlock(&ctx->next, nested);
+        copy->begin = relocateAddress(block, nested->begin, newBegin, newAddresses);
+        copy->end = copy->begin + (nested->end - nested->begin);
+
+        for(int k = 0; k < copy->end - copy->begin; k++)
+            if(hasAddress(copy->code[k].op)) copy->code[k].m = relocateAddress(block, copy->code[k].m, newBegin, newAddresses);
+
+        for(int k = 0; k < copy->numberOfExternals; k++)
+            if(copy->externals[k].type == PROC)
+                copy->externals[k].address = relocateAddress(block, copy->externals[k].address, newBegin, newAddresses);
+
+        ctx->next.stats.reusedProcedures++;
+    }
+
+    ctx->next.stats.reusedTokens += block->numberOfTokens;
+    ctx->next.stats.reusedInstructions += block->end - block->begin;
+
+    // Skip the tokens of the block
+    ctx->tokenListIterator.currentTokenInd = firstToken + block->numberOfTokens;
+
+    return 1;
+}
+
+Instruction* getInstructions(CodeGenContext* ctx, int* numberOfInstructions)
+{
+    if(numberOfInstructions) *numberOfInstructions = ctx ? ctx->nextCodeIndex : 0;
+
+    return ctx ? ctx->vmCode : NULL;
+}
+
+/**
+ * If the code emitted from begin on is a single LIT, which is the case for an
+ * operand that is a number or a CONST, removes it, frees its register and
+ * returns non-zero with its value, so that the immediate form of the operation
+ * could be emitted instead.
+ * */
+static int takeConstant(CodeGenContext* ctx, int begin, int* value)
+{
+    if(ctx->codeTooLong || ctx->nextCodeIndex != begin + 1 || ctx->vmCode[begin].op != LIT)
+        return 0;
+
+    *value = ctx->vmCode[begin].m;
+    ctx->nextCodeIndex--;
+    ctx->currentReg--;
+
+    return 1;
+}
+
+/**
+ * If the code emitted from begin on is a single copy of a variable kept in a
+ * register, "ADDI r reg 0", removes it, frees its register and returns
+ * non-zero with the register of the variable, so that the operation could
+ * read it in place.
+ * */
+static int takeRegister(CodeGenContext* ctx, int begin, int* reg)
+{
+    if(ctx->codeTooLong || ctx->nextCodeIndex != begin + 1 || ctx->vmCode[begin].op != ADDI || ctx->vmCode[begin].m != 0)
+        return 0;
+
+    *reg = ctx->vmCode[begin].l;
+    ctx->nextCodeIndex--;
+    ctx->currentReg--;
+
+    return 1;
+}
+
+/**
+ * Same as takeConstant() for the three-address target, which also takes a
+ * LOD of a variable of the current activation record and the copy of a
+ * variable kept in a register. Sets the three-address operand of the value
+ * instead.
+ * */
+static int takeOperand(CodeGenContext* ctx, int begin, int* operand)
+{
+    if(ctx->codeTooLong || ctx->nextCodeIndex != begin + 1)
+        return 0;
+
+    Instruction ins = ctx->vmCode[begin];
+
+    if(ins.op == LIT && OPERAND_VALUE(MAKE_OPERAND(OPERAND_CONSTANT, ins.m)) == ins.m)
+        *operand = MAKE_OPERAND(OPERAND_CONSTANT, ins.m);
+    else if(ins.op == LOD && ins.l == 0)
+        *operand = MAKE_OPERAND(OPERAND_VARIABLE, ins.m);
+    else if(ins.op == ADDI && ins.m == 0)
+        *operand = MAKE_OPERAND(OPERAND_REGISTER, ins.l);
+    else
+        return 0;
+
+    ctx->nextCodeIndex--;
+    ctx->currentReg--;
+
+    return 1;
+}
+
+/**
+ * For the three-address target, emits the given three-address instruction on
+ * the two values on top of the registers, whose code starts at left and
+ * right. The values that are constants or variables of the current activation
+ * record are taken as the operands instead of being loaded to registers.
+ * Arithmetic puts its result on top of the registers, and a compare and
+ * branch takes both values off.
+ *
+ * Returns the address of the instruction. Returns -1 and emits nothing if
+ * the target is not TARGET_TAC or if the value on top is computed in a
+ * register, then the caller emits the PM/0 instruction on the registers.
+ * */
+static int emitThreeAddress(CodeGenContext* ctx, int op, int left, int right)
+{
+    int a, b;
+
+    if(ctx->options.target != TARGET_TAC || !takeOperand(ctx, right, &b))
+        return -1;
+
+    if(!takeOperand(ctx, left, &a))
+        a = MAKE_OPERAND(OPERAND_REGISTER, --ctx->currentReg);
+
+    if(op >= JEQ3 && op <= JGE3)
+        return emit(ctx, op, a, b, 0);
+
+    int address = emit(ctx, op, MAKE_OPERAND(OPERAND_REGISTER, ctx->currentReg), a, b);
+    ctx->currentReg++;
+
+    return address;
+}
+
+/**
+ * Replaces the two values on top of the registers, whose code starts at left
+ * and right, with the result of the given arithmetic opcode (ADD to DIV), or
+ * takes them off by the given compare and branch (JEQ to JGE). The
+ * three-address form of the opcode is emitted for the three-address target,
+ * and its immediate form for a constant value on top, if they apply. The
+ * variables kept in registers are read in place.
+ * Returns the address of the instruction emitted.
+ * */
+static int emitOperation(CodeGenContext* ctx, int op, int left, int right)
+{
+    int isBranch = op >= JEQ && op <= JGE;
+    int a, b;
+
+    int address = emitThreeAddress(ctx, op + (isBranch ? JEQ3 - JEQ : ADD3 - ADD), left, right);
+    if(address >= 0) return address;
+
+    // The code of the left value is the last one only if the right value is taken
+    int immediate = takeConstant(ctx, right, &b);
+    if(!immediate && !takeRegister(ctx, right, &b)) b = --ctx->currentReg;
+    if(!takeRegister(ctx, left, &a)) a = --ctx->currentReg;
+
+    if(immediate) op += isBranch ? JEQI - JEQ : ADDI - ADD;
+
+    if(isBranch) return emit(ctx, op, a, b, 0);
+
+    address = emit(ctx, op, ctx->currentReg, a, b);
+    ctx->currentReg++;
+
+    return address;
+}
+
+/**
+ * Returns non-zero if the statement starting at the current token has a call
+ * statement, and sets registers to the number of registers its expressions
+ * and conditions could need: at each depth of parentheses, an expression
+ * keeps at most two values below the value of a factor, and a condition keeps
+ * its left value below. The statement of a block ends at the semicolon or the
+ * period outside of any begin and end.
+ * */
+static int summarizeStatement(CodeGenContext* ctx, int* registers)
+{
+    TokenList* tokenList = ctx->tokenListIterator.tokenList;
+    int depth = 0, parentheses = 0, deepest = 0, calls = 0;
+
+    for(int i = ctx->tokenListIterator.currentTokenInd; i < tokenList->numberOfTokens; i++)
+    {
+        int id = tokenList->tokens[i].id;
+
+        if(id == callsym) calls = 1;
+        else if(id == lparentsym && ++parentheses > deepest) deepest = parentheses;
+        else if(id == rparentsym && parentheses > 0) parentheses--;
+        else if(id == beginsym) depth++;
+        else if(id == endsym && depth > 0) depth--;
+        else if(depth == 0 && (id == semicolonsym || id == periodsym || id == endsym)) break;
+    }
+
+    *registers = 2 * deepest + 4;
+
+    return calls;
+}
+
+/**
+ * Returns the register written by the given instruction, or -1 if it writes
+ * none. An LRTN counts as writing the link register that the LCALs to its
+ * procedure write.
+ * */
+static int writtenRegister(Instruction ins)
+{
+    if(ins.op == LIT || ins.op == LOD || ins.op == SIO_READ || (ins.op >= NEG && ins.op <= GEQ) ||
+       (ins.op >= ADDI && ins.op <= DIVI) || ins.op == LCAL || ins.op == LRTN)
+        return ins.r;
+
+    if(ins.op >= MOV3 && ins.op <= DIV3 && OPERAND_KIND(ins.r) == OPERAND_REGISTER)
+        return OPERAND_VALUE(ins.r);
+
+    return -1;
+}
+
+/**
+ * Places the variables of the block being generated, its symbols from
+ * firstSymbol on, and returns the size of its activation record. The
+ * variables that escape to nested procedures already have their slots.
+ *
+ * CAL does not save the registers, so only the variables of a block that is
+ * not entered again while they are live are kept in registers: of a block
+ * whose statement calls no procedure, in the registers its expressions do not
+ * need, and of the main block, in those that no procedure writes either. They
+ * take the registers from the last one down, and the rest the next slots.
+ * */
+static int placeVariables(CodeGenContext* ctx, int firstSymbol, int calls, int registers)
+{
+    char available[REGISTER_FILE_REG_COUNT] = { 0 };
+
+    if(!calls || ctx->currentLevel == 0)
+        for(int r = registers; r < REGISTER_FILE_REG_COUNT; r++) available[r] = 1;
+
+    // The code of every procedure is before the statement of the main block
+    if(ctx->currentLevel == 0)
+    {
+        for(int i = 0; i < ctx->nextCodeIndex; i++)
+        {
+            int r = writtenRegister(ctx->vmCode[i]);
+            if(r >= 0 && r < REGISTER_FILE_REG_COUNT) available[r] = 0;
+        }
+    }
+
+    int slots = countSlots(ctx, ctx->currentScope);
+    int r = REGISTER_FILE_REG_COUNT - 1;
+
+    ctx->registerLimit = REGISTER_FILE_REG_COUNT;
+
+    for(int i = firstSymbol; i < ctx->symbolTable.numberOfSymbols; i++)
+    {
+        Symbol* symbol = &ctx->symbolTable.symbols[i];
+
+        if(symbol->type != VAR || symbol->scope != ctx->currentScope || symbol->address) continue;
+
+        while(r >= 0 && !available[r]) r--;
+
+        if(r >= 0) ctx->registerLimit = symbol->reg = r--;
+        else symbol->address = AR_VARIABLE_OFFSET + slots++;
+    }
+
+    return AR_VARIABLE_OFFSET + slots;
+}
+
+/**
+ * Returns non-zero if the block of a procedure, from firstToken to the
+ * current token, is a leaf: it declares no variables nor procedures, calls
+ * no procedure, and its expressions leave the link register free.
+ * */
+static int isLeafBlock(CodeGenContext* ctx, int firstToken)
+{
+    TokenList* tokenList = ctx->tokenListIterator.tokenList;
+    int parentheses = 0, deepest = 0;
+
+    for(int i = firstToken; i < ctx->tokenListIterator.currentTokenInd; i++)
+    {
+        int id = tokenList->tokens[i].id;
+
+        if(id == varsym || id == procsym || id == callsym) return 0;
+
+        if(id == lparentsym && ++parentheses > deepest) deepest = parentheses;
+        else if(id == rparentsym && parentheses > 0) parentheses--;
+    }
+
+    return 2 * deepest + 4 < LEAF_LINK_REGISTER;
+}
+
+/**
+ * Converts the code of the given leaf procedure, from its address to its
+ * RTN, to the leaf call convention. Its LCALs from the block it is declared
+ * in run it in the activation record of that block, one static link closer
+ * to the variables it accesses, and its RTN becomes an LRTN.
+ * */
+static void convertLeafProcedure(CodeGenContext* ctx, Symbol* procedure)
+{
+    for(int i = procedure->address; i < ctx->nextCodeIndex; i++)
+    {
+        Instruction* ins = &ctx->vmCode[i];
+
+        if(ins->op == LOD || ins->op == STO) ins->l--;
+        else if(ins->op == RTN) *ins = (Instruction){ .op = LRTN, .r = LEAF_LINK_REGISTER };
+    }
+
+    procedure->reg = LEAF_LINK_REGISTER;
+}
+
+void revertLeafProcedure(CodeGenContext* ctx, Symbol* procedure)
+{
+    // A leaf has no nested procedures, so its LRTN is the first one
+    for(int i = procedure->address; i < ctx->nextCodeIndex; i++)
+    {
+        Instruction* ins = &ctx->vmCode[i];
+
+        if(ins->op == LOD || ins->op == STO) ins->l++;
+        else if(ins->op == LRTN)
+        {
+            *ins = (Instruction){ .op = RTN };
+            break;
+        }
+    }
+
+    procedure->reg = -1;
+}
+
 // Already implemented.
-int program()
+int program(CodeGenContext* ctx)
 {
 	// Generate code for block
-    int err = block();
+    int err = block(ctx);
     if(err) return err;
 
     // After parsing block, periodsym should show up
-    if( getCurrentTokenType() == periodsym )
+    if( getCurrentTokenType(ctx) == periodsym )
     {
         // Consume token
-        nextToken();
+        nextToken(ctx);
 
         // End of program, emit halt code
-        emit(SIO_HALT, 0, 0, 3);
+        emit(ctx, SIO_HALT, 0, 0, 3);
 
         return 0;
     }
@@ -241,536 +1081,651 @@ int program()
     }
 }
 
-int block()
+int block(CodeGenContext* ctx)
 {
     int err = 0;
 	// Setup the jump address.
-	int jmpAddr = emit(JMP, 0, 0, 0);
+	int jmpAddr = emit(ctx, JMP, 0, 0, 0);
+	int firstSymbol = ctx->symbolTable.numberOfSymbols;
 	
 	// Check current token for constant, variable, or procedure type. Pass to
 	// necessary functions and perform error check.
-	if(getCurrentTokenType() == constsym && err == 0)
-		err = const_declaration();
+	if(getCurrentTokenType(ctx) == constsym && err == 0)
+		err = const_declaration(ctx);
 	if(err != 0)
 		return err;
 	
-	if(getCurrentTokenType() == varsym && err == 0)
-		err = var_declaration();
+	if(getCurrentTokenType(ctx) == varsym && err == 0)
+		err = var_declaration(ctx);
 	if(err != 0)
 		return err;
 	
-	if(getCurrentTokenType() == procsym && err == 0)
-		err = proc_declaration();
+	if(getCurrentTokenType(ctx) == procsym && err == 0)
+		err = proc_declaration(ctx);
 	if(err != 0)
 		return err;
 	
 	// Set procedure jump address.
-	vmCode[jmpAddr].m = nextCodeIndex;
-	emit(INC, 0, 0, 4);
+	ctx->vmCode[jmpAddr].m = ctx->nextCodeIndex;
+	
+	// Place the variables, now that those used by the nested procedures are
+	// known. Reserve the activation record, unless nothing is ever pushed
+	// above it: CAL has already written the header, the variables are
+	// addressed from BP, and RTN restores SP from BP.
+	int registers;
+	int calls = summarizeStatement(ctx, &registers);
+	int firstLocal = AR_VARIABLE_OFFSET + countSlots(ctx, ctx->currentScope);
+	int frameSize = placeVariables(ctx, firstSymbol, calls, registers);
+	if(calls)
+		emit(ctx, INC, 0, 0, frameSize);
 	
-	err = statement();
+	err = statement(ctx);
 	if(err != 0)
 		return err;
 	
-	emit(RTN, 0, 0, 0);
+	emit(ctx, RTN, 0, 0, 0);
+	
+	// The variables placed above are not accessed by the nested procedures
+	eliminateBlockDeadStores(ctx, ctx->vmCode[jmpAddr].m, firstLocal, frameSize);
 	
     return 0;
 }
 
-int const_declaration()
+int const_declaration(CodeGenContext* ctx)
 {
     // Do while loop parses constant declaration. Go until a comma isn't found.
     do
 	{
 		// Declare a new Symbol and set its initial values.
-		Symbol *newSym = malloc(sizeof(Symbol));
+		Symbol symbol;
+		Symbol* newSym = &symbol;
 		newSym->type = CONST;
-		newSym->level = currentLevel;
-		newSym->scope = currentScope;
+		newSym->address = 0;
+		newSym->level = ctx->currentLevel;
+		newSym->scope = ctx->currentScope;
 		
 		// Get next token and check that it is an identifier.
-		nextToken();
-		if(getCurrentTokenType() != identsym)
+		nextToken(ctx);
+		if(getCurrentTokenType(ctx) != identsym)
 			return 3;
 		// Update the symbol's name.
-		strcpy(newSym->name, getCurrentToken().lexeme);
+		strcpy(newSym->name, getCurrentToken(ctx).lexeme);
 		
 		// Get next token and check that it is an equal sign.
-		nextToken();
-		if(getCurrentTokenType() != eqsym)
+		nextToken(ctx);
+		if(getCurrentTokenType(ctx) != eqsym)
 			return 2;
 		
 		// Get the next token and check that it is a number.
-		nextToken();
-		if(getCurrentTokenType() != numbersym)
+		nextToken(ctx);
+		if(getCurrentTokenType(ctx) != numbersym)
 			return 1;
 		// Update the symbol's value.
-		newSym->value = atoi(getCurrentToken().lexeme);
+		newSym->value = atoi(getCurrentToken(ctx).lexeme);
 		
 		// Add the new symbol to the table.
-		addSymbol(&symbolTable, *newSym);
+		declareSymbol(ctx, *newSym);
 		
 		// Get next token.
-		nextToken();
-	} while(getCurrentTokenType() == commasym);
+		nextToken(ctx);
+	} while(getCurrentTokenType(ctx) == commasym);
 	
 	// Check for semicolon and get the next token.
-	if(getCurrentTokenType() != semicolonsym)
+	if(getCurrentTokenType(ctx) != semicolonsym)
 		return 10;
-	nextToken();
+	nextToken(ctx);
 
     // Successful parsing.
     return 0;
 }
 
-int var_declaration()
+int var_declaration(CodeGenContext* ctx)
 {
 	// Do while loop parses variable declaration. Go until a comma isn't found.
     do
 	{
 		// Declare a new Symbol and set its initial values.
-		Symbol* newSym = malloc(sizeof(Symbol));
+		Symbol symbol;
+		Symbol* newSym = &symbol;
 		newSym->type = VAR;
-		newSym->level = currentLevel;
-		newSym->scope = currentScope;
-		newSym->address = nextCodeIndex;
+		newSym->level = ctx->currentLevel;
+		newSym->scope = ctx->currentScope;
+		newSym->address = 0;
+		newSym->reg = -1;
 		
 		// Get next token and check that it is an identifier.
-		nextToken();
-		if(getCurrentTokenType() != identsym)
+		nextToken(ctx);
+		if(getCurrentTokenType(ctx) != identsym)
 			return 3;
 		// Update the symbol's name.
-		strcpy(newSym->name, getCurrentToken().lexeme);
+		strcpy(newSym->name, getCurrentToken(ctx).lexeme);
 		
-		// Add the new symbol to the table and INC for the variable.
-		addSymbol(&symbolTable, *newSym);
-		emit(INC, 0, 0, 1);
+		// Add the new symbol to the table, it is placed by block().
+		declareSymbol(ctx, *newSym);
 		
 		// Get the next token.
-		nextToken();
-	} while(getCurrentTokenType() == commasym);
+		nextToken(ctx);
+	} while(getCurrentTokenType(ctx) == commasym);
 	
 	// Check for semicolon and get the next token.
-	if(getCurrentTokenType() != semicolonsym)
+	if(getCurrentTokenType(ctx) != semicolonsym)
 		return 4;
-	nextToken();
+	nextToken(ctx);
 
     return 0;
 }
 
-int proc_declaration()
+int proc_declaration(CodeGenContext* ctx)
 {
     // Error variable for tracking error codes.
 	int err = 0;
 	
 	// While loop parses procedure declaration.
-    while(getCurrentTokenType() == procsym)
+    while(getCurrentTokenType(ctx) == procsym)
 	{
 		// Declare a new Symbol and set its initial values.
-		Symbol* tempSym = currentScope;
-		Symbol* newSym = malloc(sizeof(Symbol));
+		Symbol* tempSym = ctx->currentScope;
+		Symbol* newSym = addScope(ctx);
 		newSym->type = PROC;
-		newSym->level = currentLevel;
-		newSym->scope = currentScope;
-		newSym->address = nextCodeIndex;
+		newSym->level = ctx->currentLevel;
+		newSym->scope = ctx->currentScope;
+		newSym->address = ctx->nextCodeIndex;
+		newSym->reg = -1;
 		
 		// Get next token and check that it is an identifier.
-		nextToken();
-		if(getCurrentTokenType() != identsym)
+		nextToken(ctx);
+		if(getCurrentTokenType(ctx) != identsym)
 			return 3;
 		// Update the symbol's name.
-		strcpy(newSym->name, getCurrentToken().lexeme);
+		strcpy(newSym->name, getCurrentToken(ctx).lexeme);
 		
-		// Add the new symbol to the table.
-		addSymbol(&symbolTable, *newSym);
+		// Add the new symbol to the table, which could be moved by the
+		// symbols of the block.
+		int index = ctx->symbolTable.numberOfSymbols;
+		declareSymbol(ctx, *newSym);
 		
 		// Get next token and check that it is a semicolon.
-		nextToken();
-		if(getCurrentTokenType() != semicolonsym)
+		nextToken(ctx);
+		if(getCurrentTokenType(ctx) != semicolonsym)
 			return 5;
 		
 		// Get next token.
-		nextToken();
+		nextToken(ctx);
+		int firstToken = ctx->tokenListIterator.currentTokenInd;
 		
 		
 		// Increment the current level for the next block and decrement it after 
 		// the block is finished. Also set the scope before and after block.
-		currentScope = newSym;
-		currentLevel++;
+		ctx->currentScope = newSym;
+		ctx->currentLevel++;
 		
-		err = block();
-		if(err != 0)
-			return err;
+		// Copy the code of the block if it is unchanged since the previous
+		// code generation. Otherwise, generate and record it.
+		if(!ctx->previous || !reuseProcedureBlock(ctx, newSym))
+		{
+			if(ctx->previous)
+				beginBlockRecording(ctx);
+			
+			err = block(ctx);
+			if(err != 0)
+				return err;
+			
+			if(ctx->previous)
+				endBlockRecording(ctx, newSym);
+		}
+		
+		// A leaf procedure is called with LCAL from the block it is declared
+		// in. The code is recorded with CAL and RTN, and converted the same
+		// way whether it is generated or copied.
+		if(isLeafBlock(ctx, firstToken))
+			convertLeafProcedure(ctx, &ctx->symbolTable.symbols[index]);
 		
-		currentLevel--;
-		currentScope = tempSym;
+		// Record the code of the procedure for the symbol side-file.
+		if(ctx->options.symbols)
+			addProcedureRange(&ctx->debugInfo, newSym, newSym->address, ctx->vmCode[newSym->address].m, ctx->nextCodeIndex);
+		
+		ctx->currentLevel--;
+		ctx->currentScope = tempSym;
 		
 		// Check for semicolon after new block.
-		if(getCurrentTokenType() != semicolonsym)
+		if(getCurrentTokenType(ctx) != semicolonsym)
 			return 5;
 		
 		// Get next token.
-		nextToken();
+		nextToken(ctx);
 	}
 
     return 0;
 }
 
-int statement()
+int statement(CodeGenContext* ctx)
 {
     // Error variable for tracking error codes.
 	int err = 0, jmp, jmp2;
 	Symbol* currSym;
 	
 	// Statement that begins with an identifier symbol.
-    if(getCurrentTokenType() == identsym)
+    if(getCurrentTokenType(ctx) == identsym)
 	{	
-		currSym = findSymbol(&symbolTable, currentScope, getCurrentToken().lexeme);
+		currSym = lookupSymbol(ctx, getCurrentToken(ctx).lexeme);
 		
 		// Check the scope and type of current symbol.
-		if(currSym->scope != currentScope)
+		if(currSym == NULL)
 			return 15;
 		if(currSym->type != VAR)
 			return 16;
 		
 		// Get next token and check if it is a become symbol.
-		nextToken();
-		if(getCurrentTokenType() != becomessym)
+		nextToken(ctx);
+		if(getCurrentTokenType(ctx) != becomessym)
 			return 7;
 		
 		// Get next token and pass to expression.
-		nextToken();
-		err = expression();
+		nextToken(ctx);
+		int begin = ctx->nextCodeIndex;
+		err = expression(ctx);
 		if(err != 0)
 			return err;
+		
+		// Store the value of the expression to the variable. A variable kept
+		// in a register is the destination of the last operation instead, or
+		// is copied to. For the three-address target, a variable of the
+		// current activation record is the destination of the last operation
+		// or of a MOV3 as well.
+		int operand;
+		int last = ctx->nextCodeIndex - 1;
+		int computed = last >= begin && !ctx->codeTooLong;
+		int tac = ctx->options.target == TARGET_TAC && ctx->currentLevel == currSym->level;
+		int destination = currSym->reg >= 0 ? MAKE_OPERAND(OPERAND_REGISTER, currSym->reg)
+		                                    : MAKE_OPERAND(OPERAND_VARIABLE, currSym->address);
+		if(tac && takeOperand(ctx, begin, &operand))
+		{
+			emit(ctx, MOV3, destination, operand, 0);
+		}
+		else if(tac && computed && ctx->vmCode[last].op >= ADD3 && ctx->vmCode[last].op <= DIV3)
+		{
+			ctx->currentReg--;
+			ctx->vmCode[last].r = destination;
+		}
+		else if(currSym->reg >= 0)
+		{
+			ctx->currentReg--;
+			if(computed && writtenRegister(ctx->vmCode[last]) == ctx->currentReg && ctx->vmCode[last].op < MOV3)
+				ctx->vmCode[last].r = currSym->reg;
+			else
+				emit(ctx, ADDI, currSym->reg, ctx->currentReg, 0);
+		}
+		else
+		{
+			ctx->currentReg--;
+			emit(ctx, STO, ctx->currentReg, ctx->currentLevel - currSym->level, currSym->address);
+		}
 	}
 	// Statement that begins with a call symbol.
-	else if(getCurrentTokenType() == callsym)
+	else if(getCurrentTokenType(ctx) == callsym)
 	{
 		// Get next token and check if it is an identifier.
-		nextToken();
-		if(getCurrentTokenType() != identsym)
+		nextToken(ctx);
+		if(getCurrentTokenType(ctx) != identsym)
 			return 8;
 		
-		currSym = findSymbol(&symbolTable, currentScope, getCurrentToken().lexeme);
+		currSym = lookupSymbol(ctx, getCurrentToken(ctx).lexeme);
 		
 		// Check scope and type of current symbol.
-		if(currSym->scope != currentScope)
+		if(currSym == NULL)
 			return 15;
-		if(currSym->type == PROC)
-			emit(CAL, 0, currentLevel - currSym->level, currSym->address);
-		else
+		if(currSym->type != PROC)
 			return 17;
 		
+		// A leaf procedure runs in the activation record of its caller, which
+		// has to be the block it is declared in. From a nested block, it is
+		// turned back to a procedure called with CAL.
+		if(currSym->reg >= 0 && ctx->currentLevel != currSym->level)
+			revertLeafProcedure(ctx, currSym);
+		
+		if(currSym->reg >= 0)
+			emit(ctx, LCAL, currSym->reg, 0, currSym->address);
+		else
+			emit(ctx, CAL, 0, ctx->currentLevel - currSym->level, currSym->address);
+		
 		// Get next token.
-		nextToken();
+		nextToken(ctx);
 	}
 	// Statement that begins with begin symbol.
-	else if(getCurrentTokenType() == beginsym)
+	else if(getCurrentTokenType(ctx) == beginsym)
 	{
 		// Get next token and pass to statement.
-		nextToken();
-		err = statement();
+		nextToken(ctx);
+		err = statement(ctx);
 		if(err != 0)
 			return err;
 		
-		while (getCurrentTokenType() == semicolonsym)
+		while (getCurrentTokenType(ctx) == semicolonsym)
 		{
 			// Get next token and pass to statement.
-			nextToken();
-			err = statement();
+			nextToken(ctx);
+			err = statement(ctx);
 			if(err != 0)
 				return err;
 		}
 		
 		// Check for end symbol and get the next token.
-		if(getCurrentTokenType() != endsym)
+		if(getCurrentTokenType(ctx) != endsym)
 			return 10;
-		nextToken();
+		nextToken(ctx);
 	}
 	// Statement that begins with if symbol.
-	else if(getCurrentTokenType() == ifsym)
+	else if(getCurrentTokenType(ctx) == ifsym)
 	{
 		// Get next token and pass to condition.
-		nextToken();
-		err = condition();
+		nextToken(ctx);
+		err = condition(ctx);
 		if(err != 0)
 			return err;
 		
 		// Check the token is a then symbol.
-		if(getCurrentTokenType() != thensym)
+		if(getCurrentTokenType(ctx) != thensym)
 			return 9;
 		
 		// Get next token.
-		nextToken();
+		nextToken(ctx);
 		
 		// Set jump address.
-		jmp = nextCodeIndex;
-		emit(JPC, 0, 0, 0);
+		jmp = ctx->conditionBranch;
 		
 		// Run statement and check for error.
-		err = statement();
+		err = statement(ctx);
 		if(err != 0)
 			return err;
 		
-		// Update jump address.
-		vmCode[jmp].m = nextCodeIndex;
-		
 		// Check for else statement. Get the next token and pass
 		// to statement if an else token is the current token.
-		if(getCurrentTokenType() == elsesym)
+		if(getCurrentTokenType(ctx) == elsesym)
 		{
-			// Set else jump address.
-			jmp2 = nextCodeIndex;
-			emit(JMP, 0, 0, 0);
+			// Jump over the else statement at the end of the then statement.
+			jmp2 = ctx->nextCodeIndex;
+			emit(ctx, JMP, 0, 0, 0);
 			
-			// Get the next token and update else jump address.
-			nextToken();
-			vmCode[jmp2].m = nextCodeIndex;
+			// The condition jumps to the else statement when false.
+			ctx->vmCode[jmp].m = ctx->nextCodeIndex;
 			
-			// Run statement and check for error.
-			err = statement();
+			// Get the next token, run statement and check for error.
+			nextToken(ctx);
+			err = statement(ctx);
 			if(err != 0)
 				return err;
 			
-			vmCode[jmp].m = nextCodeIndex;
+			ctx->vmCode[jmp2].m = ctx->nextCodeIndex;
 		}
+		// Update jump address.
+		else
+			ctx->vmCode[jmp].m = ctx->nextCodeIndex;
 	}
 	// Statement that begins with while symbol.
-	else if(getCurrentTokenType() == whilesym)
+	else if(getCurrentTokenType(ctx) == whilesym)
 	{
-		jmp = nextCodeIndex;
+		jmp = ctx->nextCodeIndex;
 		
 		// Get next token and pass to condition.
-		nextToken();
-		err = condition();
+		nextToken(ctx);
+		err = condition(ctx);
 		if(err != 0)
 			return err;
 		
-		jmp2 = nextCodeIndex;
-		emit(JPC, 0, 0, 0);
+		jmp2 = ctx->conditionBranch;
 		
 		// Check the token is a do symbol.
-		if(getCurrentTokenType() != dosym)
+		if(getCurrentTokenType(ctx) != dosym)
 			return 11;
 		
 		// Get next token and pass to statement.
-		nextToken();
-		err = statement();
+		nextToken(ctx);
+		err = statement(ctx);
 		if(err != 0)
 			return err;
 		
 		// Jump back to while.
-		emit(JMP, 0, 0, jmp);
-		vmCode[jmp2].m = nextCodeIndex;
+		emit(ctx, JMP, 0, 0, jmp);
+		ctx->vmCode[jmp2].m = ctx->nextCodeIndex;
 	}
 	// Statement that begins with write symbol.
-	else if(getCurrentTokenType() == writesym)
+	else if(getCurrentTokenType(ctx) == writesym)
 	{
 		// Get next token and check if its an identifier.
-		nextToken();
-		if(getCurrentTokenType() != identsym)
+		nextToken(ctx);
+		if(getCurrentTokenType(ctx) != identsym)
 			return 3;
 		
 		// Get current symbol and check its scope and type.
-		currSym = findSymbol(&symbolTable, currentScope, getCurrentToken().lexeme);
-		if(currSym->scope != currentScope)
+		currSym = lookupSymbol(ctx, getCurrentToken(ctx).lexeme);
+		if(currSym == NULL)
 			return 15;
 		if(currSym->type == PROC)
 			return 18;
 		
-		emit(LOD, 0, currentLevel - currSym->level, currSym->address);
-		emit(SIO_WRITE, 0, 0, 0);
+		// Load the value to a register, unless the variable is kept in one.
+		if(currSym->type == CONST)
+			emit(ctx, LIT, 0, 0, currSym->value);
+		else if(currSym->reg < 0)
+			emit(ctx, LOD, 0, ctx->currentLevel - currSym->level, currSym->address);
+		emit(ctx, SIO_WRITE, currSym->type == VAR && currSym->reg >= 0 ? currSym->reg : 0, 0, 0);
 		
 		// Get next token.
-		nextToken();
+		nextToken(ctx);
 	}
 	// Statement that begins with read symbol.
-	else if(getCurrentTokenType() == readsym)
+	else if(getCurrentTokenType(ctx) == readsym)
 	{
-		emit(SIO_READ, 0, 0, 0);
+		int read = emit(ctx, SIO_READ, 0, 0, 0);
 		
 		// Get next token and check if its an identifier.
-		nextToken();
-		if(getCurrentTokenType() != identsym)
+		nextToken(ctx);
+		if(getCurrentTokenType(ctx) != identsym)
 			return 3;
 		
 		// Get current symbol and check its scope and type.
-		currSym = findSymbol(&symbolTable, currentScope, getCurrentToken().lexeme);
-		if(currSym->scope != currentScope)
+		currSym = lookupSymbol(ctx, getCurrentToken(ctx).lexeme);
+		if(currSym == NULL)
 			return 15;
 		if(currSym->type != VAR)
 			return 19;
 		
-		// Get next token.
-		nextToken();
-		emit(STO, 0, currentLevel - currSym->level, currSym->address);
+		// Get next token. Read to the register of the variable or store it.
+		nextToken(ctx);
+		if(currSym->reg >= 0 && !ctx->codeTooLong)
+			ctx->vmCode[read].r = currSym->reg;
+		else
+			emit(ctx, STO, 0, ctx->currentLevel - currSym->level, currSym->address);
 	}
 
     return 0;
 }
 
-int condition()
+int condition(CodeGenContext* ctx)
 {
 	int err = 0;
 	
 	// Check for odd symbols.
-	if(getCurrentTokenType() == oddsym)
+	if(getCurrentTokenType(ctx) == oddsym)
 	{
-		nextToken();
+		nextToken(ctx);
 		
 		// Run expression and then emit the ODD.
-		err = expression();
+		err = expression(ctx);
 		if(err != 0)
 			return err;
 		
-		emit(ODD, 0, 0, 0);
+		// Jump when the value is even.
+		ctx->currentReg--;
+		emit(ctx, ODD, ctx->currentReg, 0, 0);
+		ctx->conditionBranch = emit(ctx, JPC, ctx->currentReg, 0, 0);
 	}
 	else
 	{
 		// Run expression then check for relational operations.
-		err = expression();
+		int left = ctx->nextCodeIndex;
+		err = expression(ctx);
 		if(err != 0)
 			return err;
 		
-		if(getCurrentTokenType() == eqsym)
-			emit(EQL, 0, 0, 0);
-		else if(getCurrentTokenType() == neqsym)
-			emit(NEQ, 0, 0, 0);
-		else if(getCurrentTokenType() == leqsym)
-			emit(LEQ, 0, 0, 0);
-		else if(getCurrentTokenType() == geqsym)
-			emit(GEQ, 0, 0, 0);
-		else if(getCurrentTokenType() == lessym)
-			emit(LSS, 0, 0, 0);
-		else if(getCurrentTokenType() == gtrsym)
-			emit(GTR, 0, 0, 0);
+		// The branch is taken when the relation does not hold, so the
+		// opposite relation is compared.
+		int op;
+		if(getCurrentTokenType(ctx) == eqsym)
+			op = JNE;
+		else if(getCurrentTokenType(ctx) == neqsym)
+			op = JEQ;
+		else if(getCurrentTokenType(ctx) == leqsym)
+			op = JGT;
+		else if(getCurrentTokenType(ctx) == geqsym)
+			op = JLT;
+		else if(getCurrentTokenType(ctx) == lessym)
+			op = JGE;
+		else if(getCurrentTokenType(ctx) == gtrsym)
+			op = JLE;
 		else
 			return 12;
 		
-		nextToken();
+		nextToken(ctx);
+		
+		int begin = ctx->nextCodeIndex;
+		err = expression(ctx);
+		if(err != 0)
+			return err;
+		
+		// Compare both sides and branch in a single instruction.
+		ctx->conditionBranch = emitOperation(ctx, op, left, begin);
 	}
 	
-	err = expression();
-	if(err != 0)
-		return err;
-	
     return 0;
 }
 
-int expression()
+int expression(CodeGenContext* ctx)
 {
 	// Error variable for tracking error codes.
 	int err = 0;
-	int op = getCurrentTokenType();
+	int op = getCurrentTokenType(ctx);
+	int left = ctx->nextCodeIndex;
 	
 	// Get the next token if the current is a plus or minus sign.
     if(op == plussym || op == minussym)
 	{
-		nextToken();
+		nextToken(ctx);
 		
-		err = term();
+		err = term(ctx);
 		if(err != 0)
 			return err;
 		
 		if(op == minussym)
-			emit(NEG, 0, 0, 0);
+			emit(ctx, NEG, ctx->currentReg - 1, ctx->currentReg - 1, 0);
 	} 
-	
-	err = term();
-	if(err != 0)
-		return err;
+	else
+	{
+		err = term(ctx);
+		if(err != 0)
+			return err;
+	}
 	
 	// Continue parsing until the end of the expression.
+	op = getCurrentTokenType(ctx);
 	while(op == plussym || op == minussym)
 	{
-		nextToken();
+		nextToken(ctx);
 		
-		err = term();
+		int begin = ctx->nextCodeIndex;
+		err = term(ctx);
 		if(err != 0)
 			return err;
 		
-		if(op == plussym)
-			emit(ADD, 0, 0, 0);
-		else
-			emit(SUB, 0, 0, 0);
+		// Replace the two values on top of the registers with the result.
+		emitOperation(ctx, op == plussym ? ADD : SUB, left, begin);
+		
+		op = getCurrentTokenType(ctx);
 	}
 
     return 0;
 }
 
-int term()
+int term(CodeGenContext* ctx)
 {
     // Error variable for tracking errors.
 	int err = 0;
-	int op = getCurrentTokenType();
+	int left = ctx->nextCodeIndex;
 	
-    err = factor();
+    err = factor(ctx);
 	if(err != 0)
 		return err;
 	
 	// Continue parsing until the end of the term expression.
+	int op = getCurrentTokenType(ctx);
 	while(op == multsym || op == slashsym)
 	{
-		nextToken();
+		nextToken(ctx);
 		
-		err = factor();
+		int begin = ctx->nextCodeIndex;
+		err = factor(ctx);
 		if(err != 0)
 			return err;
 		
-		if(op == multsym)
-			emit(MUL, 0, 0, 0);
-		else
-			emit(DIV, 0, 0, 0);
+		// Replace the two values on top of the registers with the result.
+		emitOperation(ctx, op == multsym ? MUL : DIV, left, begin);
+		
+		op = getCurrentTokenType(ctx);
 	}
 
     return 0;
 }
 
-int factor()
+int factor(CodeGenContext* ctx)
 {
-	// Create current symbol and check for symbol scope.
-	Symbol* currSym = findSymbol(&symbolTable, currentScope, getCurrentToken().lexeme);
-	if(currSym == NULL)
-		return 15;
-	
     // Is the current token a identsym?
-    if(getCurrentTokenType() == identsym)
+    if(getCurrentTokenType(ctx) == identsym)
     {	
-		// Check current symbol type.
+		// Create current symbol and check for symbol scope.
+		Symbol* currSym = lookupSymbol(ctx, getCurrentToken(ctx).lexeme);
+		if(currSym == NULL)
+			return 15;
+		
+		// Check current symbol type, and load its value to a new register.
 		if(currSym->type == PROC)
 			return 14;
+		else if(ctx->currentReg >= ctx->registerLimit)
+			return 21;
 		else if(currSym->type == CONST)
-			emit(LIT, 0, 0, currSym->value);
+			emit(ctx, LIT, ctx->currentReg++, 0, currSym->value);
+		else if(currSym->reg >= 0)
+			emit(ctx, ADDI, ctx->currentReg++, currSym->reg, 0);
 		else
-			emit(LOD, 0, currentLevel - currSym->level, currSym->address);
+			emit(ctx, LOD, ctx->currentReg++, ctx->currentLevel - currSym->level, currSym->address);
 		
         // Consume identsym
-        nextToken(); // Go to the next token..
+        nextToken(ctx); // Go to the next token..
 
         // Success
         return 0;
     }
     // Is that a numbersym?
-    else if(getCurrentTokenType() == numbersym)
+    else if(getCurrentTokenType(ctx) == numbersym)
     {	
-		int value = atoi(getCurrentToken().lexeme);
-		emit(LIT, 0, 0, value);
+		int value = atoi(getCurrentToken(ctx).lexeme);
+		if(ctx->currentReg >= ctx->registerLimit)
+			return 21;
+		emit(ctx, LIT, ctx->currentReg++, 0, value);
 		
         // Consume numbersym
-        nextToken(); // Go to the next token..
+        nextToken(ctx); // Go to the next token..
 
         // Success
         return 0;
     }
     // Is that a lparentsym?
-    else if(getCurrentTokenType() == lparentsym)
+    else if(getCurrentTokenType(ctx) == lparentsym)
     {
         // Consume lparentsym
-        nextToken(); // Go to the next token..
+        nextToken(ctx); // Go to the next token..
 
         // Continue by parsing expression.
-        int err = expression();
+        int err = expression(ctx);
 
         /**
          * If parsing of expression was not successful, immediately stop parsing
@@ -780,7 +1735,7 @@ int factor()
         if(err) return err;
 
         // After expression, right-parenthesis should come
-        if(getCurrentTokenType() != rparentsym)
+        if(getCurrentTokenType(ctx) != rparentsym)
         {
             /**
              * Error code 13: Right parenthesis missing.
@@ -790,7 +1745,7 @@ int factor()
         }
 		
         // It was a rparentsym. Consume rparentsym.
-        nextToken(); // Go to the next token..
+        nextToken(ctx); // Go to the next token..
     }
     else
     {
@@ -2,9 +2,140 @@
 #define __CODE_GENERATOR_H__
 
 #include "token.h"
+#include "data.h"
+#include "incremental.h"
+#include "metrics.h"
+#include "optimizer.h"
 
+/**
+ * Output formats of codeGenerator()
+ *  TARGET_PM0: PM/0 code, one instruction per line (default)
+ *  TARGET_C  : A C translation unit, see c_backend.h
+ *  TARGET_TAC: PM/0 code in which the operations of expressions and
+ *              conditions take the constants and the variables of the current
+ *              activation record as operands, by the three-address
+ *              instructions MOV3 to JGE3 of data.h. Same format as TARGET_PM0.
+ * */
+typedef enum {
+    TARGET_PM0,
+    TARGET_C,
+    TARGET_TAC
+} CodeGeneratorTarget;
+
+/**
+ * Statistics of a single code generation.
+ *
+ * arenaAllocations, arenaBytes: The objects allocated from the arena of the
+ *     code generation, see arena.h, and their total size.
+ * arenaChunkAllocations: The chunks the arena allocated with malloc(), which
+ *     is 0 once a CodeGenContext is warmed up by a code generation.
+ * heapAllocations: The other allocations and reallocations of the code
+ *     generation, made to grow the code array and the symbol table.
+ * */
+typedef struct {
+    long arenaAllocations;
+    long arenaBytes;
+    long arenaChunkAllocations;
+    long heapAllocations;
+} CodeGeneratorStats;
+
+/**
+ * Options of a single code generation.
+ *
+ * symbols: If not NULL, the symbol side-file is written to it after a
+ *          successful code generation. The side-file maps instruction
+ *          ranges to procedures, variables to their levels and slots, and
+ *          tokens to the instructions generated for them. See
+ *          printDebugInfo() in debug_info.h for its format.
+ *
+ * maxCodeLength: The maximum number of instructions to generate. A program
+ *                that needs more fails with error code 20. Defaults to
+ *                MAX_CODE_LENGTH if not positive.
+ *
+ * incremental: If not NULL, the blocks of the procedures whose tokens, level
+ *              and external symbols are unchanged since the code generation
+ *              the state was recorded by are copied instead of generated.
+ *              After a successful code generation, the state is replaced by
+ *              the blocks of this one and its stats tell the work skipped.
+ *              Ignored if symbols is not NULL or for TARGET_TAC.
+ *
+ * stats: If not NULL, filled with the statistics of the code generation.
+ *
+ * metrics: If not NULL, the time of parsing, of each optimization pass and of
+ *          printing the code, and the counters of the code generation are
+ *          added to it. See metrics.h.
+ *
+ * disabledPasses: The OptimizationPass flags of the passes that are not run
+ *                 on the generated code. See optimizer.h.
+ * */
+typedef struct {
+    CodeGeneratorTarget target;
+    FILE* symbols;
+    int maxCodeLength;
+    IncrementalState* incremental;
+    CodeGeneratorStats* stats;
+    Metrics* metrics;
+    unsigned disabledPasses;
+} CodeGeneratorOptions;
+
+/**
+ * Generates PM/0 code for the given token list and writes it to the given
+ * file. Returns 0 on success, otherwise the code generator error code.
+ *
+ * Each call keeps its state in its own context, so calls on different token
+ * lists and files could run concurrently on different threads.
+ * */
 int codeGenerator(TokenList, FILE*);
 
+/**
+ * Same as codeGenerator(), with the given options instead of the defaults
+ * (TARGET_PM0, no symbol side-file).
+ * */
+int codeGeneratorWithOptions(TokenList, FILE*, const CodeGeneratorOptions*);
+
 void printCGErr(int errCode, FILE*);
 
+/**
+ * Handle of a code generator that keeps the generated instructions in memory
+ * instead of writing them to a file. A handle runs a single code generation
+ * at a time, but any number of handles could be used concurrently from
+ * different threads. Nothing in the code generator calls exit().
+ * */
+typedef struct CodeGenContext CodeGenContext;
+
+/**
+ * Creates a code generator handle. It could be reused for any number of code
+ * generations.
+ * */
+CodeGenContext* createCodeGenContext();
+
+/**
+ * Generates code for the given token list. options could be NULL for the
+ * defaults, options->target only tells whether the three-address instructions
+ * are generated (TARGET_TAC).
+ *
+ * Returns 0 on success, otherwise the code generator error code. The
+ * instructions of the previous code generation of the handle are discarded.
+ * */
+int compileTokenList(CodeGenContext*, TokenList*, const CodeGeneratorOptions* options);
+
+/**
+ * Returns the instructions generated by the last successful compileTokenList()
+ * call and sets numberOfInstructions. There are no instructions after an
+ * unsuccessful call. The instructions are owned by the handle and are valid
+ * until the next compileTokenList() or destroyCodeGenContext() call.
+ * */
+Instruction* getInstructions(CodeGenContext*, int* numberOfInstructions);
+
+/**
+ * Writes the instructions generated by the last successful compileTokenList()
+ * call to the given file, in the target format of the options of the call.
+ * */
+void printGeneratedCode(CodeGenContext*, FILE*);
+
+/**
+ * Deallocates the given code generator handle.
+ * */
+void destroyCodeGenContext(CodeGenContext*);
+
 #endif
\ No newline at end of file
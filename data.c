@@ -42,7 +42,9 @@ const char* codeGeneratorErrMsg[] =
     [16] = "Assignment to constant or procedure is not allowed",
     [17] = "Call of a constant or variable is not allowed",
     [18] = "Write of a prodecure is not allowed",
-    [19] = "Read to a constant or prodecure is not allowed"
+    [19] = "Read to a constant or prodecure is not allowed",
+    [20] = "Generated code exceeds the maximum code length",
+    [21] = "Expression needs more registers than the register file has"
 };
 
 const char* nonTerminalNames[] = {
@@ -67,5 +69,20 @@ const char* opcodeNames[] = {
     
     [NEG] = "NEG", [ADD] = "ADD", [SUB] = "SUB", [MUL] = "MUL", [DIV] = "DIV",
     [ODD] = "ODD", [MOD] = "MOD", [EQL] = "EQL", [NEQ] = "NEQ", [LSS] = "LSS",
-    [LEQ] = "LEQ", [GTR] = "GTR", [GEQ] = "GEQ"
+    [LEQ] = "LEQ", [GTR] = "GTR", [GEQ] = "GEQ",
+
+    [JEQ] = "JEQ", [JNE] = "JNE", [JLT] = "JLT", [JLE] = "JLE", [JGT] = "JGT",
+    [JGE] = "JGE",
+
+    [ADDI] = "ADDI", [SUBI] = "SUBI", [MULI] = "MULI", [DIVI] = "DIVI",
+
+    [JEQI] = "JEQI", [JNEI] = "JNEI", [JLTI] = "JLTI", [JLEI] = "JLEI",
+    [JGTI] = "JGTI", [JGEI] = "JGEI",
+
+    [MOV3] = "MOV3", [ADD3] = "ADD3", [SUB3] = "SUB3", [MUL3] = "MUL3", [DIV3] = "DIV3",
+
+    [JEQ3] = "JEQ3", [JNE3] = "JNE3", [JLT3] = "JLT3", [JLE3] = "JLE3",
+    [JGT3] = "JGT3", [JGE3] = "JGE3",
+
+    [LCAL] = "LCAL", [LRTN] = "LRTN"
 };
\ No newline at end of file
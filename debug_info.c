@@ -0,0 +1,108 @@
+#include "debug_info.h"
+#include <stdlib.h>
+
+void initDebugInfo(DebugInfo* debugInfo)
+{
+    debugInfo->procedures = NULL;
+    debugInfo->numberOfProcedures = 0;
+
+    debugInfo->tokens = NULL;
+    debugInfo->numberOfTokens = 0;
+}
+
+void deleteDebugInfo(DebugInfo* debugInfo)
+{
+    if(!debugInfo) return;
+
+    free(debugInfo->procedures);
+    free(debugInfo->tokens);
+
+    initDebugInfo(debugInfo);
+}
+
+void addProcedureRange(DebugInfo* debugInfo, Symbol* procedure, int begin, int body, int end)
+{
+    if(!debugInfo) return;
+
+    debugInfo->numberOfProcedures++;
+
+    debugInfo->procedures = (ProcedureRange*)realloc(debugInfo->procedures, debugInfo->numberOfProcedures * sizeof(ProcedureRange));
+
+    debugInfo->procedures[debugInfo->numberOfProcedures - 1] = (ProcedureRange){
+        .procedure = procedure, .begin = begin, .body = body, .end = end
+    };
+}
+
+void addTokenAddress(DebugInfo* debugInfo, int tokenIndex, int address)
+{
+    if(!debugInfo) return;
+
+    // Tokens are recorded in order, so only the last one has to be checked
+    if(debugInfo->numberOfTokens && debugInfo->tokens[debugInfo->numberOfTokens - 1].tokenIndex == tokenIndex)
+        return;
+
+    // Grow by doubling, since a token is recorded for most emitted instructions
+    int n = debugInfo->numberOfTokens;
+    if( (n & (n - 1)) == 0 )
+        debugInfo->tokens = (TokenAddress*)realloc(debugInfo->tokens, (n ? 2 * n : 1) * sizeof(TokenAddress));
+
+    debugInfo->tokens[debugInfo->numberOfTokens++] = (TokenAddress){ .tokenIndex = tokenIndex, .address = address };
+}
+
+void relocateDebugInfo(DebugInfo* debugInfo, const int* addresses)
+{
+    if(!debugInfo) return;
+
+    for(int i = 0; i < debugInfo->numberOfProcedures; i++)
+    {
+        ProcedureRange* range = &debugInfo->procedures[i];
+
+        // The CALs to a procedure whose JMP over its nested procedures is
+        // removed go to its body, and so does its address
+        if(addresses[range->begin] == addresses[range->begin + 1])
+            range->begin = addresses[range->body];
+        else
+            range->begin = addresses[range->begin];
+
+        range->body = addresses[range->body];
+        range->end = addresses[range->end];
+    }
+
+    for(int i = 0; i < debugInfo->numberOfTokens; i++)
+    {
+        debugInfo->tokens[i].address = addresses[debugInfo->tokens[i].address];
+    }
+}
+
+void printDebugInfo(DebugInfo* debugInfo, SymbolTable* symbolTable, FILE* out)
+{
+    if(!debugInfo || !symbolTable || !out) return;
+
+    fprintf(out, "# proc <address> <name> <end> <level> <body>\n");
+    for(int i = 0; i < debugInfo->numberOfProcedures; i++)
+    {
+        ProcedureRange* range = &debugInfo->procedures[i];
+
+        fprintf(out, "proc %d %s %d %u %d\n",
+            range->begin, range->procedure->name, range->end, range->procedure->level + 1, range->body);
+    }
+
+    fprintf(out, "# var <name> <level> <slot> <scope>\n");
+    for(int i = 0; i < symbolTable->numberOfSymbols; i++)
+    {
+        Symbol* symbol = &symbolTable->symbols[i];
+
+        if(symbol->type != VAR) continue;
+
+        if(symbol->reg >= 0)
+            fprintf(out, "var %s %u r%d %s\n",
+                symbol->name, symbol->level, symbol->reg, symbol->scope ? symbol->scope->name : "-");
+        else
+            fprintf(out, "var %s %u %u %s\n",
+                symbol->name, symbol->level, symbol->address, symbol->scope ? symbol->scope->name : "-");
+    }
+
+    fprintf(out, "# token <index> <address>\n");
+    for(int i = 0; i < debugInfo->numberOfTokens; i++)
+        fprintf(out, "token %d %d\n", debugInfo->tokens[i].tokenIndex, debugInfo->tokens[i].address);
+}
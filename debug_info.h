@@ -0,0 +1,94 @@
+#ifndef __DEBUG_INFO_H__
+#define __DEBUG_INFO_H__
+
+#include <stdio.h>
+#include "symbol.h"
+
+/**
+ * Instructions [begin, end) are the code of the procedure of the given
+ * symbol, which includes the code of its nested procedures. body is the
+ * first instruction of its statement.
+ * */
+typedef struct {
+    Symbol* procedure;
+    int begin;
+    int body;
+    int end;
+} ProcedureRange;
+
+/**
+ * The first instruction emitted while the token at tokenIndex was the current
+ * token of the code generator.
+ * */
+typedef struct {
+    int tokenIndex;
+    int address;
+} TokenAddress;
+
+/**
+ * Information collected while generating code to map the generated code back
+ * to the PL/0 program.
+ * */
+typedef struct {
+    ProcedureRange* procedures;
+    int numberOfProcedures;
+
+    TokenAddress* tokens;
+    int numberOfTokens;
+} DebugInfo;
+
+/**
+ * Initializes the given debug info to an empty one.
+ * */
+void initDebugInfo(DebugInfo*);
+
+/**
+ * Deallocates the members of the given debug info.
+ * */
+void deleteDebugInfo(DebugInfo*);
+
+/**
+ * Appends the range of instructions of the given procedure.
+ * */
+void addProcedureRange(DebugInfo*, Symbol* procedure, int begin, int body, int end);
+
+/**
+ * Records that an instruction is emitted at address while the token at
+ * tokenIndex is the current token. Only the first instruction of each token
+ * is recorded.
+ * */
+void addTokenAddress(DebugInfo*, int tokenIndex, int address);
+
+/**
+ * Moves the recorded addresses to the new addresses of the instructions
+ * after an optimization pass, addresses[a] being the new address of the
+ * instruction at a.
+ * */
+void relocateDebugInfo(DebugInfo*, const int* addresses);
+
+/**
+ * Writes the symbol side-file, one entry per line:
+ *
+ *   proc <address> <name> <end> <level> <body>
+ *       Instructions [address, end) belong to the procedure, including
+ *       the code of its nested procedures. Its statement starts at body and
+ *       its variables are at the given level. address is the target of the
+ *       CALs to the procedure. When jump threading removes the JMP over
+ *       the nested procedures, address is moved to the first instruction
+ *       of the procedure itself, after its nested procedures.
+ *
+ *   var <name> <level> <slot> <scope>
+ *       A variable at the given lexicographical level, stored in the given
+ *       slot of the activation record of its scope: the name of the
+ *       declaring procedure, or "-" for the main block. The slot of a
+ *       variable kept in a register is "r" and the number of the register.
+ *
+ *   token <index> <address>
+ *       The first instruction generated for the token at the given index
+ *       of the token list.
+ *
+ * Lines starting with '#' are comments.
+ * */
+void printDebugInfo(DebugInfo*, SymbolTable*, FILE*);
+
+#endif
@@ -0,0 +1,173 @@
+#include "incremental.h"
+#include <stdlib.h>
+#include <string.h>
+
+void initIncrementalState(IncrementalState* state)
+{
+    state->blocks = NULL;
+    state->numberOfBlocks = 0;
+
+    memset(&state->stats, 0, sizeof(IncrementalStats));
+}
+
+void deleteIncrementalState(IncrementalState* state)
+{
+    if(!state) return;
+
+    for(int i = 0; i < state->numberOfBlocks; i++)
+    {
+        free(state->blocks[i].code);
+        free(state->blocks[i].externals);
+    }
+
+    free(state->blocks);
+
+    initIncrementalState(state);
+}
+
+ProcedureBlock* addProcedureBlock(IncrementalState* state, const ProcedureBlock* block)
+{
+    state->numberOfBlocks++;
+    state->blocks = (ProcedureBlock*)realloc(state->blocks, state->numberOfBlocks * sizeof(ProcedureBlock));
+
+    ProcedureBlock* copy = &state->blocks[state->numberOfBlocks - 1];
+    *copy = *block;
+
+    int numberOfInstructions = block->end - block->begin;
+    copy->code = (Instruction*)malloc((numberOfInstructions + 1) * sizeof(Instruction));
+    memcpy(copy->code, block->code, numberOfInstructions * sizeof(Instruction));
+
+    copy->externals = (ExternalSymbol*)malloc((block->numberOfExternals + 1) * sizeof(ExternalSymbol));
+    memcpy(copy->externals, block->externals, block->numberOfExternals * sizeof(ExternalSymbol));
+
+    return copy;
+}
+
+unsigned long long hashProcedureBlock(unsigned level, const Token* tokens, int numberOfTokens)
+{
+    Token levelToken = { .id = (int)level, .lexeme = "" };
+
+    return hashTokens(tokens, numberOfTokens, hashTokens(&levelToken, 1, TOKEN_HASH_BASIS));
+}
+
+ProcedureBlock* findProcedureBlock(IncrementalState* state, const char* name, unsigned level, TokenList* tokenList, int firstToken)
+{
+    if(!state) return NULL;
+
+    for(int i = 0; i < state->numberOfBlocks; i++)
+    {
+        ProcedureBlock* block = &state->blocks[i];
+
+        if(block->level != level || strcmp(block->name, name)) continue;
+        if(firstToken + block->numberOfTokens > tokenList->numberOfTokens) continue;
+
+        if(hashProcedureBlock(level, tokenList->tokens + firstToken, block->numberOfTokens) == block->hash)
+            return block;
+    }
+
+    return NULL;
+}
+
+int relocateAddress(const ProcedureBlock* block, int old, int newBegin, const unsigned* newAddresses)
+{
+    if(old >= block->begin && old < block->end) return old - block->begin + newBegin;
+
+    // External symbols are declared before the block, so are below begin
+    for(int i = 0; i < block->numberOfExternals; i++)
+    {
+        const ExternalSymbol* external = &block->externals[i];
+
+        if(external->type == PROC && (int)external->address == old)
+            return newAddresses[i];
+    }
+
+    return old;
+}
+
+void writeIncrementalState(IncrementalState* state, FILE* out)
+{
+    fprintf(out, "incremental %d\n", state->numberOfBlocks);
+
+    for(int i = 0; i < state->numberOfBlocks; i++)
+    {
+        ProcedureBlock* block = &state->blocks[i];
+
+        fprintf(out, "block %s %u %d %llu %d %d %d\n", block->name, block->level, block->numberOfTokens,
+            block->hash, block->begin, block->end, block->numberOfExternals);
+
+        for(int k = 0; k < block->end - block->begin; k++)
+        {
+            Instruction c = block->code[k];
+            fprintf(out, "%d %d %d %d\n", c.op, c.r, c.l, c.m);
+        }
+
+        for(int k = 0; k < block->numberOfExternals; k++)
+        {
+            ExternalSymbol* external = &block->externals[k];
+
+            fprintf(out, "external %s %d %d %u %u\n", external->name, external->type, external->value,
+                external->level, external->address);
+        }
+    }
+}
+
+int readIncrementalState(IncrementalState* state, FILE* in)
+{
+    initIncrementalState(state);
+
+    int numberOfBlocks;
+    if( fscanf(in, " incremental %d", &numberOfBlocks) != 1 || numberOfBlocks < 0 ) return -1;
+
+    for(int i = 0; i < numberOfBlocks; i++)
+    {
+        ProcedureBlock block;
+
+        if( fscanf(in, " block %11s %u %d %llu %d %d %d", block.name, &block.level, &block.numberOfTokens,
+                &block.hash, &block.begin, &block.end, &block.numberOfExternals) != 7 ||
+            block.begin < 0 || block.end < block.begin || block.numberOfExternals < 0 )
+        {
+            deleteIncrementalState(state);
+            return -1;
+        }
+
+        int numberOfInstructions = block.end - block.begin;
+        block.code = (Instruction*)malloc((numberOfInstructions + 1) * sizeof(Instruction));
+        block.externals = (ExternalSymbol*)malloc((block.numberOfExternals + 1) * sizeof(ExternalSymbol));
+
+        int valid = 1;
+
+        for(int k = 0; valid && k < numberOfInstructions; k++)
+        {
+            Instruction* c = &block.code[k];
+            valid = fscanf(in, " %d %d %d %d", &c->op, &c->r, &c->l, &c->m) == 4;
+        }
+
+        for(int k = 0; valid && k < block.numberOfExternals; k++)
+        {
+            ExternalSymbol* external = &block.externals[k];
+            valid = fscanf(in, " external %11s %d %d %u %u", external->name, &external->type, &external->value,
+                &external->level, &external->address) == 5;
+        }
+
+        if(valid) addProcedureBlock(state, &block);
+
+        free(block.code);
+        free(block.externals);
+
+        if(!valid)
+        {
+            deleteIncrementalState(state);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void printIncrementalStats(IncrementalStats* stats, FILE* out)
+{
+    fprintf(out, "incremental: reused %d of %d procedures, skipped %d of %d tokens, copied %d of %d instructions\n",
+        stats->reusedProcedures, stats->reusedProcedures + stats->generatedProcedures,
+        stats->reusedTokens, stats->numberOfTokens,
+        stats->reusedInstructions, stats->numberOfInstructions);
+}
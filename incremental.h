@@ -0,0 +1,119 @@
+#ifndef __INCREMENTAL_H__
+#define __INCREMENTAL_H__
+
+#include <stdio.h>
+#include "data.h"
+#include "symbol.h"
+#include "token.h"
+
+/**
+ * A symbol looked up by the code of a procedure but declared outside of it,
+ * as it was when the code was generated. type is -1 if the symbol was not
+ * found. address is the address the code refers to the symbol by.
+ * */
+typedef struct {
+    char name[12];
+    int type;
+    int value;
+    unsigned level;
+    unsigned address;
+} ExternalSymbol;
+
+/**
+ * The code generated for the block of a procedure, which is the same for
+ * the same tokens, level and external symbols. Instructions [begin, end) of
+ * the generation it was recorded from are kept in code.
+ *
+ * The block of a procedure is the tokens after "procedure (name) ;" up to
+ * the semicolon that ends the declaration.
+ * */
+typedef struct {
+    char name[12];
+    unsigned level;
+
+    int numberOfTokens;
+    unsigned long long hash;
+
+    int begin;
+    int end;
+    Instruction* code;
+
+    ExternalSymbol* externals;
+    int numberOfExternals;
+} ProcedureBlock;
+
+/**
+ * Counts of the work done and skipped by the last incremental code generation.
+ * */
+typedef struct {
+    int reusedProcedures;
+    int generatedProcedures;
+    int reusedTokens;
+    int numberOfTokens;
+    int reusedInstructions;
+    int numberOfInstructions;
+} IncrementalStats;
+
+/**
+ * The procedure blocks of the last successful code generation, to be reused
+ * by the next one. See CodeGeneratorOptions.incremental.
+ * */
+typedef struct {
+    ProcedureBlock* blocks;
+    int numberOfBlocks;
+
+    IncrementalStats stats;
+} IncrementalState;
+
+/**
+ * Initializes the given state to an empty one.
+ * */
+void initIncrementalState(IncrementalState*);
+
+/**
+ * Deallocates the members of the given state.
+ * */
+void deleteIncrementalState(IncrementalState*);
+
+/**
+ * Appends a copy of the given block, including a copy of its code and external
+ * symbols, and returns the appended block.
+ * */
+ProcedureBlock* addProcedureBlock(IncrementalState*, const ProcedureBlock*);
+
+/**
+ * Returns the 64-bit hash of a procedure block: its level and its tokens.
+ * */
+unsigned long long hashProcedureBlock(unsigned level, const Token* tokens, int numberOfTokens);
+
+/**
+ * Returns a block of the given procedure whose tokens are the same as the
+ * tokens starting at firstToken in the given token list, or NULL if there is
+ * none.
+ * */
+ProcedureBlock* findProcedureBlock(IncrementalState*, const char* name, unsigned level, TokenList*, int firstToken);
+
+/**
+ * Returns the new address of old, an address the code of the given block
+ * refers to: the addresses in [begin, end) are moved to newBegin, and the
+ * addresses of the external procedures to the given new addresses.
+ * */
+int relocateAddress(const ProcedureBlock*, int old, int newBegin, const unsigned* newAddresses);
+
+/**
+ * Writes the state to a text file to be read by readIncrementalState().
+ * */
+void writeIncrementalState(IncrementalState*, FILE*);
+
+/**
+ * Reads a state written by writeIncrementalState(). Returns -1 and an empty
+ * state if the file is not a valid state.
+ * */
+int readIncrementalState(IncrementalState*, FILE*);
+
+/**
+ * Writes a line of the counts of work done and skipped.
+ * */
+void printIncrementalStats(IncrementalStats*, FILE*);
+
+#endif
@@ -1,17 +1,141 @@
+#define _GNU_SOURCE
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "token.h"
 #include "code_generator.h"
+#include "server.h"
+#include "cache.h"
 
 int main(int argc, char **argv)
 {
     FILE *inp, *outp;
+    CodeGeneratorOptions options = { .target = TARGET_PM0, .symbols = NULL };
+    const char* symbolPath = NULL;
+    const char* socketPath = NULL;
+    Cache cache = { .directory = getenv("CG_CACHE_DIR"), .maxSize = DEFAULT_CACHE_SIZE };
+    int printStats = 0;
+    const char* statePath = NULL;
+    IncrementalState state;
+    CodeGeneratorStats stats;
+    int printAllocations = 0;
+    const char* metricsFormat = getenv("CG_METRICS");
+    Metrics metrics;
+    int argi = 1;
 
     /**********************************/
     /* Parse Command Line Arguments */
     /**********************************/
+    // Options precede the file arguments
+    while(argi < argc && argv[argi][0] == '-' && argv[argi][1] != '\0')
+    {
+        if( !strcmp(argv[argi], "-c") )
+        {
+            options.target = TARGET_C;
+            argi++;
+        }
+        else if( !strcmp(argv[argi], "-t") )
+        {
+            options.target = TARGET_TAC;
+            argi++;
+        }
+        else if( !strcmp(argv[argi], "-g") && argi + 1 < argc )
+        {
+            symbolPath = argv[argi + 1];
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-i") && argi + 1 < argc )
+        {
+            statePath = argv[argi + 1];
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-k") && argi + 1 < argc )
+        {
+            cache.directory = argv[argi + 1];
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-K") && argi + 1 < argc )
+        {
+            cache.maxSize = atoll(argv[argi + 1]);
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-a") )
+        {
+            options.stats = &stats;
+            printAllocations = 1;
+            argi++;
+        }
+        else if( !strcmp(argv[argi], "-m") && argi + 1 < argc )
+        {
+            metricsFormat = argv[argi + 1];
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-O0") )
+        {
+            options.disabledPasses = ~0u;
+            argi++;
+        }
+        else if( !strcmp(argv[argi], "-S") )
+        {
+            printStats = 1;
+            argi++;
+        }
+        else if( !strcmp(argv[argi], "-d") && argi + 1 < argc )
+        {
+            socketPath = argv[argi + 1];
+            argi += 2;
+        }
+        else break;
+    }
+
+    // Instrument the code generation - if requested
+    if(metricsFormat && metricsFormat[0])
+    {
+        initMetrics(&metrics);
+        options.metrics = &metrics;
+    }
+
+    // Shift the options out of the arguments
+    argc -= argi - 1;
+    argv += argi - 1;
+
+    // Server mode takes no file arguments
+    if(socketPath && argc == 1) return runServer(socketPath, &options) ? -1 : 0;
+
+    // Printing the statistics of the cache takes no file arguments either
+    if(printStats && cache.directory && cache.directory[0] && argc == 1)
+    {
+        printCacheStats(&cache, stdout);
+        return 0;
+    }
+
     if(argc != 3)
     {
-        fprintf(stderr, "Usage: ./code_generator.out (pl0_lexer_out) (cg_output_file)\n");
+        fprintf(stderr, "Usage: ./code_generator.out [-c | -t] [-a] [-g symbol_file] [-i state_file] [-k cache_dir [-K max_bytes] [-S]] [-m text|json] [-O0] (pl0_lexer_out) (cg_output_file)\n");
+        fprintf(stderr, "       ./code_generator.out [-c | -t] -d socket_path\n");
+        fprintf(stderr, "       ./code_generator.out -k cache_dir -S\n");
+
+        fprintf(stderr, "\n       -c: Output a C translation unit instead of PM/0 assembly code. Compile it with the system compiler to get a native executable of the PL/0 program.\n");
+
+        fprintf(stderr, "\n       -t: Output PM/0 code with the three-address instructions, which take the constants and the local variables as operands instead of loading them to registers. Ignores the state_file.\n");
+
+        fprintf(stderr, "\n       symbol_file: The path to the file to write the symbol side-file to, which maps the addresses of the generated code to the procedures of the PL/0 program. Read by the profiler of the virtual machine.\n");
+
+        fprintf(stderr, "\n       state_file: Incremental code generation. The code of the procedures that are unchanged since the code generation that wrote the state file is copied from it instead of generated. The state file is then replaced. Ignored with -g.\n");
+
+        fprintf(stderr, "\n       -a: Print the memory allocations of the code generation to stderr.\n");
+
+        fprintf(stderr, "\n       -m: Print the time of each stage of the code generation and its counters to stderr, as a table (text) or as a JSON object (json). Defaults to $CG_METRICS if set.\n");
+
+        fprintf(stderr, "\n       -O0: Do not optimize the generated code. By default, dead store elimination removes the stores to the local variables that are not read afterwards, and jump threading collapses the chains of branches. The cache is bypassed.\n");
+
+        fprintf(stderr, "\n       cache_dir: Look up and store the outputs in a content addressed cache in the directory, which could be shared by many code generators. Defaults to $CG_CACHE_DIR if set. The cache is bypassed if a symbol_file is requested.\n");
+
+        fprintf(stderr, "\n       -K max_bytes: The size limit of the cache, above which the least recently used outputs are evicted. Defaults to %lld.\n", DEFAULT_CACHE_SIZE);
+
+        fprintf(stderr, "\n       -S: Print the hits, misses and evictions of the cache.\n");
+
+        fprintf(stderr, "\n       socket_path: Run as a server listening on the Unix domain socket at the path, which compiles the lexer outputs sent by cg_client.out until interrupted. See server.h for the protocol.\n");
 
         fprintf(stderr, "\n       pl0_lexer_out: The path to the file containing the lexer out for the programming language PL/0.\n");
 
@@ -37,17 +161,98 @@ int main(int argc, char **argv)
         return -1;
     }              
 
+    // open the symbol side-file for writing
+    if( symbolPath && !(options.symbols = fopen(symbolPath, "w")) )
+    {
+        fprintf(stderr, "Could not open \"%s\"\n", symbolPath);
+
+        // Before terminating, close the input and the output files
+        fclose(inp);
+        fclose(outp);
+
+        return -1;
+    }
+
+    // Read the blocks of the previous code generation - if there is any
+    if(statePath)
+    {
+        FILE* statep = fopen(statePath, "r");
+
+        if( !statep || readIncrementalState(&state, statep) ) initIncrementalState(&state);
+        if(statep) fclose(statep);
+
+        options.incremental = &state;
+    }
+
     /**********************************/
     /**** Call to code generator   ****/
     /**********************************/
     // Read the token list
+    long long start = options.metrics ? readClock() : 0;
     TokenList tokenList = readTokenList(inp);
+    if(options.metrics) addStageTime(options.metrics, "read", readClock() - start);
     
-    // Run code generator
-    int err = codeGenerator(tokenList, outp);
+    // The symbol side-file is not cached
+    int cached = cache.directory && cache.directory[0] && !options.symbols && !options.disabledPasses;
+    int err = 0, generated = 0;
+
+    if(cached) setCacheKey(&cache, &tokenList, &options);
+
+    if(options.metrics) start = readClock();
+    int hit = cached && lookupCache(&cache, outp, &err);
+    if(options.metrics && cached) addStageTime(options.metrics, "cache", readClock() - start);
+
+    if(!hit)
+    {
+        // The output is buffered to be stored in the cache
+        char* output = NULL;
+        size_t length = 0;
+        FILE* bufferp = cached ? open_memstream(&output, &length) : outp;
+
+        // Run code generator
+        err = codeGeneratorWithOptions(tokenList, bufferp, &options);
+        generated = 1;
+
+        // Print error - if there exists any
+        if(err) printCGErr(err, bufferp);
+
+        if(cached)
+        {
+            fclose(bufferp);
 
-    // Print error - if there exists any
-    if(err) printCGErr(err, outp);
+            fwrite(output, 1, length, outp);
+            storeCache(&cache, err, output, length);
+
+            free(output);
+        }
+    }
+
+    if(printStats && cached) printCacheStats(&cache, stderr);
+
+    if(printAllocations && generated)
+    {
+        fprintf(stderr, "allocations: %ld from the arena (%ld bytes) in %ld chunks, %ld other\n",
+            stats.arenaAllocations, stats.arenaBytes, stats.arenaChunkAllocations, stats.heapAllocations);
+    }
+
+    if(options.metrics) printMetrics(options.metrics, strcmp(metricsFormat, "json") ? METRICS_TEXT : METRICS_JSON, stderr);
+
+    // Write the blocks of this code generation for the next one
+    if(statePath)
+    {
+        // The state is kept as it is on errors and cache hits
+        FILE* statep = generated && !err && !options.symbols ? fopen(statePath, "w") : NULL;
+
+        if(statep)
+        {
+            writeIncrementalState(&state, statep);
+            fclose(statep);
+
+            printIncrementalStats(&state.stats, stderr);
+        }
+
+        deleteIncrementalState(&state);
+    }
 
     // Delete token list created by readTokenList()
     deleteTokenList(&tokenList);
@@ -59,6 +264,7 @@ int main(int argc, char **argv)
     // close the input and the output file stream
     if(inp) fclose(inp);
     if(outp) fclose(outp);
+    if(options.symbols) fclose(options.symbols);
 
     return 0;
 }
@@ -0,0 +1,80 @@
+#define _GNU_SOURCE
+#include "metrics.h"
+#include <string.h>
+#include <time.h>
+
+void initMetrics(Metrics* metrics)
+{
+    memset(metrics, 0, sizeof(Metrics));
+}
+
+long long readClock()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+void addStageTime(Metrics* metrics, const char* name, long long nanoseconds)
+{
+    if(!metrics) return;
+
+    int i = 0;
+    while(i < metrics->numberOfStages && strcmp(metrics->stages[i].name, name)) i++;
+
+    if(i == metrics->numberOfStages)
+    {
+        if(i == MAX_METRIC_STAGES) return;
+
+        metrics->stages[i].name = name;
+        metrics->stages[i].nanoseconds = 0;
+        metrics->numberOfStages++;
+    }
+
+    metrics->stages[i].nanoseconds += nanoseconds;
+}
+
+static void printText(Metrics* metrics, FILE* out)
+{
+    long long total = 0;
+
+    fprintf(out, "%-22s %12s\n", "stage", "time (ms)");
+
+    for(int i = 0; i < metrics->numberOfStages; i++)
+    {
+        fprintf(out, "%-22s %12.3f\n", metrics->stages[i].name, metrics->stages[i].nanoseconds / 1e6);
+        total += metrics->stages[i].nanoseconds;
+    }
+
+    fprintf(out, "%-22s %12.3f\n", "total", total / 1e6);
+
+    fprintf(out, "%-22s %12ld\n", "tokens consumed", metrics->tokensConsumed);
+    fprintf(out, "%-22s %12ld\n", "symbols added", metrics->symbolsAdded);
+    fprintf(out, "%-22s %12ld\n", "symbol lookups", metrics->symbolLookups);
+    fprintf(out, "%-22s %12ld\n", "symbol probes", metrics->symbolProbes);
+    fprintf(out, "%-22s %12ld\n", "instructions emitted", metrics->instructionsEmitted);
+}
+
+static void printJSON(Metrics* metrics, FILE* out)
+{
+    fprintf(out, "{\"stages_ns\": {");
+
+    for(int i = 0; i < metrics->numberOfStages; i++)
+    {
+        fprintf(out, "%s\"%s\": %lld", i ? ", " : "", metrics->stages[i].name, metrics->stages[i].nanoseconds);
+    }
+
+    fprintf(out, "}, \"tokens_consumed\": %ld, \"symbols_added\": %ld, \"symbol_lookups\": %ld, "
+                 "\"symbol_probes\": %ld, \"instructions_emitted\": %ld}\n",
+        metrics->tokensConsumed, metrics->symbolsAdded, metrics->symbolLookups,
+        metrics->symbolProbes, metrics->instructionsEmitted);
+}
+
+void printMetrics(Metrics* metrics, MetricsFormat format, FILE* out)
+{
+    if(!metrics || !out) return;
+
+    if(format == METRICS_JSON) printJSON(metrics, out);
+    else                       printText(metrics, out);
+}
@@ -0,0 +1,74 @@
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdio.h>
+
+/**
+ * Maximum number of stages timed by Metrics.
+ * */
+#define MAX_METRIC_STAGES 16
+
+/**
+ * Wall time spent in a stage of the code generation, in nanoseconds.
+ * */
+typedef struct {
+    const char* name;
+    long long nanoseconds;
+} StageTime;
+
+/**
+ * Instrumentation of the code generation, see CodeGeneratorOptions.
+ *
+ * stages: The time of each stage, in the order the stages were first run:
+ *     "read" for readTokenList(), "parse" for parsing and emitting code,
+ *     one stage per optimization pass, and "print" for printing the code.
+ *
+ * tokensConsumed: Tokens the parser advanced over, including those of the
+ *     procedures copied by incremental code generation.
+ * symbolsAdded: Symbols added to the symbol table.
+ * symbolLookups, symbolProbes: findSymbol() calls, and the symbols of the
+ *     symbol table they compared with the name looked up.
+ * instructionsEmitted: Instructions emitted by the parser.
+ * */
+typedef struct {
+    StageTime stages[MAX_METRIC_STAGES];
+    int numberOfStages;
+
+    long tokensConsumed;
+    long symbolsAdded;
+    long symbolLookups;
+    long symbolProbes;
+    long instructionsEmitted;
+} Metrics;
+
+/**
+ * Output formats of printMetrics()
+ * */
+typedef enum {
+    METRICS_TEXT,
+    METRICS_JSON
+} MetricsFormat;
+
+/**
+ * Initializes the given metrics to no stages and zero counters.
+ * */
+void initMetrics(Metrics*);
+
+/**
+ * Returns the time of a monotonic clock in nanoseconds, to measure stages.
+ * */
+long long readClock();
+
+/**
+ * Adds the given time to the stage with the given name, which is added after
+ * the other stages if it is new. The name should be a string literal.
+ * */
+void addStageTime(Metrics*, const char* name, long long nanoseconds);
+
+/**
+ * Writes the stage times and the counters, either as a table or as a single
+ * line JSON object.
+ * */
+void printMetrics(Metrics*, MetricsFormat, FILE*);
+
+#endif
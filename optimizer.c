@@ -0,0 +1,440 @@
+#include <stdlib.h>
+#include <string.h>
+#include "optimizer.h"
+
+/**
+ * Returns whether the opcode is a compare and branch.
+ * */
+static int isCompareBranch(int op)
+{
+    return (op >= JEQ && op <= JGE) || (op >= JEQI && op <= JGEI) || (op >= JEQ3 && op <= JGE3);
+}
+
+/**
+ * Returns whether the instruction transfers the control to its M.
+ * */
+static int isBranch(Instruction* ins)
+{
+    return ins->op == JMP || ins->op == JPC || ins->op == CAL || ins->op == LCAL || isCompareBranch(ins->op);
+}
+
+/**
+ * Returns whether the instruction never continues with the next one.
+ * */
+static int isUnconditional(Instruction* ins)
+{
+    return ins->op == JMP || ins->op == RTN || ins->op == LRTN || ins->op == SIO_HALT;
+}
+
+/**
+ * Returns the compare, or the compare and branch, of the negation of the
+ * relation of the given one. Returns 0 if the given opcode is neither.
+ * */
+static int oppositeCompare(int op)
+{
+    switch(op)
+    {
+        case EQL: return NEQ;
+        case NEQ: return EQL;
+        case LSS: return GEQ;
+        case GEQ: return LSS;
+        case GTR: return LEQ;
+        case LEQ: return GTR;
+
+        case JEQ: return JNE;
+        case JNE: return JEQ;
+        case JLT: return JGE;
+        case JGE: return JLT;
+        case JGT: return JLE;
+        case JLE: return JGT;
+
+        case JEQI: return JNEI;
+        case JNEI: return JEQI;
+        case JLTI: return JGEI;
+        case JGEI: return JLTI;
+        case JGTI: return JLEI;
+        case JLEI: return JGTI;
+
+        case JEQ3: return JNE3;
+        case JNE3: return JEQ3;
+        case JLT3: return JGE3;
+        case JGE3: return JLT3;
+        case JGT3: return JLE3;
+        case JLE3: return JGT3;
+
+        default:  return 0;
+    }
+}
+
+/**
+ * Follows the chain of JMPs starting at the given address and returns the
+ * address of the first instruction that is not a JMP. A chain longer than the
+ * code is a loop, which is left at wherever it is.
+ * */
+static int finalDestination(Instruction* code, int numberOfInstructions, int address)
+{
+    for(int steps = 0; steps < numberOfInstructions; steps++)
+    {
+        if(address < 0 || address >= numberOfInstructions || code[address].op != JMP)
+            break;
+
+        address = code[address].m;
+    }
+
+    return address;
+}
+
+int threadJumps(Instruction* code, int numberOfInstructions, int* addresses)
+{
+    int n = numberOfInstructions;
+
+    if(n <= 0) return 0;
+
+    // Retarget the branches to the final destinations of their chains
+    for(int i = 0; i < n; i++)
+    {
+        if(isBranch(&code[i])) code[i].m = finalDestination(code, n, code[i].m);
+    }
+
+    char* removed = calloc(n, 1);
+    char* targeted = malloc(n + 1);
+    int* next = malloc((n + 1) * sizeof(int));
+
+    /**
+     * Removing an instruction could make another one removable, as a JMP
+     * could then jump to the next instruction or follow a JMP. Repeat until
+     * nothing is removed.
+     * */
+    int changed = 1;
+    while(changed)
+    {
+        changed = 0;
+
+        // next[i] is the first instruction kept at or after i
+        next[n] = n;
+        for(int i = n - 1; i >= 0; i--) next[i] = removed[i] ? next[i + 1] : i;
+
+        // The instructions that are the targets of the branches kept
+        memset(targeted, 0, n + 1);
+        for(int i = 0; i < n; i++)
+        {
+            if(!removed[i] && isBranch(&code[i]) && code[i].m >= 0 && code[i].m <= n)
+                targeted[code[i].m] = 1;
+        }
+
+        int previous = -1;
+
+        for(int i = 0; i < n; i++)
+        {
+            if(removed[i]) continue;
+
+            Instruction* ins = &code[i];
+
+            // The JMP that a conditional branch over a JMP jumps over
+            int j = next[i + 1];
+            int overJump = j < n && code[j].op == JMP && ins->m == next[j + 1] && !targeted[j];
+
+            if(overJump && isCompareBranch(ins->op))
+            {
+                ins->op = oppositeCompare(ins->op);
+                ins->m = code[j].m;
+
+                removed[j] = 1;
+                changed = 1;
+            }
+            else if(overJump && ins->op == JPC && previous >= 0 && !targeted[i]
+                && oppositeCompare(code[previous].op) && code[previous].r == ins->r)
+            {
+                code[previous].op = oppositeCompare(code[previous].op);
+                ins->m = code[j].m;
+
+                removed[j] = 1;
+                changed = 1;
+            }
+            else if(ins->op == JMP && (ins->m == next[i + 1]
+                || (!targeted[i] && previous >= 0 && isUnconditional(&code[previous]))))
+            {
+                removed[i] = 1;
+                changed = 1;
+                continue;
+            }
+
+            previous = i;
+        }
+    }
+
+    // The new address of each instruction, a removed one gets the next kept one
+    int* map = addresses ? addresses : next;
+
+    int kept = 0;
+    for(int i = 0; i < n; i++)
+    {
+        map[i] = kept;
+        if(!removed[i]) kept++;
+    }
+    map[n] = kept;
+
+    // Move the instructions kept to their new addresses, relocating the branches
+    for(int i = 0; i < n; i++)
+    {
+        if(removed[i]) continue;
+
+        code[map[i]] = code[i];
+
+        Instruction* ins = &code[map[i]];
+        if(isBranch(ins) && ins->m >= 0 && ins->m <= n) ins->m = map[ins->m];
+    }
+
+    free(removed);
+    free(targeted);
+    free(next);
+
+    return kept;
+}
+
+/**
+ * A set of locals, one bit each
+ * */
+typedef unsigned long long LocalSet;
+
+#define LOCAL_SET_BITS 64
+
+/**
+ * The locals of the code of a block: the registers, then the slots of its
+ * activation record from firstLocal to numberOfSlots. words is the number
+ * of LocalSets that hold a set of them.
+ * */
+typedef struct {
+    int firstLocal, numberOfSlots;
+    int words;
+} Locals;
+
+/**
+ * Returns the local of the given register, -1 if it is out of the register file.
+ * */
+static int registerLocal(int r)
+{
+    return r >= 0 && r < REGISTER_FILE_REG_COUNT ? r : -1;
+}
+
+/**
+ * Returns the local of the given slot of the current activation record, -1
+ * if it is not a local.
+ * */
+static int slotLocal(Locals* locals, int slot)
+{
+    if(slot < locals->firstLocal || slot >= locals->numberOfSlots) return -1;
+
+    return REGISTER_FILE_REG_COUNT + slot - locals->firstLocal;
+}
+
+/**
+ * Returns the local of the given three-address operand, -1 for a constant or
+ * a slot that is not a local.
+ * */
+static int operandLocal(Locals* locals, int operand)
+{
+    switch(OPERAND_KIND(operand))
+    {
+        case OPERAND_REGISTER: return registerLocal(OPERAND_VALUE(operand));
+        case OPERAND_VARIABLE: return slotLocal(locals, OPERAND_VALUE(operand));
+        default:               return -1;
+    }
+}
+
+/**
+ * Sets uses to the locals that the given instruction reads, -1 for none, and
+ * returns the local it writes, -1 for none. Sets keep if the instruction has
+ * an effect besides writing that local.
+ * */
+static int getLocals(Locals* locals, Instruction ins, int uses[2], int* keep)
+{
+    int written = -1;
+
+    uses[0] = uses[1] = -1;
+    *keep = 0;
+
+    switch(ins.op)
+    {
+        case LIT:
+            written = registerLocal(ins.r);
+            break;
+
+        case LOD:
+            if(ins.l == 0) uses[0] = slotLocal(locals, ins.m);
+            written = registerLocal(ins.r);
+            break;
+
+        case STO:
+            uses[0] = registerLocal(ins.r);
+            if(ins.l == 0) written = slotLocal(locals, ins.m);
+            *keep = written < 0;
+            break;
+
+        case NEG:
+        case ADDI: case SUBI: case MULI: case DIVI:
+            uses[0] = registerLocal(ins.l);
+            written = registerLocal(ins.r);
+            *keep = ins.op == DIVI && ins.m == 0;
+            break;
+
+        case ODD:
+            uses[0] = written = registerLocal(ins.r);
+            break;
+
+        case ADD: case SUB: case MUL: case DIV: case MOD:
+        case EQL: case NEQ: case LSS: case LEQ: case GTR: case GEQ:
+            uses[0] = registerLocal(ins.l);
+            uses[1] = registerLocal(ins.m);
+            written = registerLocal(ins.r);
+            *keep = ins.op == DIV || ins.op == MOD;
+            break;
+
+        case MOV3: case ADD3: case SUB3: case MUL3: case DIV3:
+            uses[0] = operandLocal(locals, ins.l);
+            if(ins.op != MOV3) uses[1] = operandLocal(locals, ins.m);
+            written = operandLocal(locals, ins.r);
+            *keep = written < 0 || (ins.op == DIV3 && (OPERAND_KIND(ins.m) != OPERAND_CONSTANT || OPERAND_VALUE(ins.m) == 0));
+            break;
+
+        case JEQ3: case JNE3: case JLT3: case JLE3: case JGT3: case JGE3:
+            uses[0] = operandLocal(locals, ins.r);
+            uses[1] = operandLocal(locals, ins.l);
+            *keep = 1;
+            break;
+
+        case JEQ: case JNE: case JLT: case JLE: case JGT: case JGE:
+            uses[0] = registerLocal(ins.r);
+            uses[1] = registerLocal(ins.l);
+            *keep = 1;
+            break;
+
+        case JPC: case SIO_WRITE: case LRTN:
+        case JEQI: case JNEI: case JLTI: case JLEI: case JGTI: case JGEI:
+            uses[0] = registerLocal(ins.r);
+            *keep = 1;
+            break;
+
+        // Reads the input, or writes the return address of a call
+        case SIO_READ: case LCAL:
+            written = registerLocal(ins.r);
+            *keep = 1;
+            break;
+
+        default:
+            *keep = 1;
+            break;
+    }
+
+    return written;
+}
+
+#define HAS_LOCAL(set, k) (((set)[(k) / LOCAL_SET_BITS] >> ((k) % LOCAL_SET_BITS)) & 1)
+#define ADD_LOCAL(set, k) ((set)[(k) / LOCAL_SET_BITS] |= 1ULL << ((k) % LOCAL_SET_BITS))
+#define REMOVE_LOCAL(set, k) ((set)[(k) / LOCAL_SET_BITS] &= ~(1ULL << ((k) % LOCAL_SET_BITS)))
+
+/**
+ * Computes the locals live at the start of each instruction from begin to
+ * end into live, and marks the instructions that write only a local that is
+ * not live after them as removed. A removed instruction reads nothing, so
+ * the instructions computing the values that only it reads are removed as
+ * well. Starting with nothing live, the loops of the code are followed
+ * backwards until nothing changes.
+ * */
+static void computeLiveness(Locals* locals, Instruction* code, int begin, int end, char* removed, LocalSet* live)
+{
+    int words = locals->words;
+    LocalSet* out = malloc(words * sizeof(LocalSet));
+
+    memset(live, 0, (size_t)(end - begin) * words * sizeof(LocalSet));
+
+    int changed = 1;
+    while(changed)
+    {
+        changed = 0;
+
+        for(int i = end - 1; i >= begin; i--)
+        {
+            Instruction* ins = &code[i];
+            LocalSet* in = live + (size_t)(i - begin) * words;
+
+            // The locals live after the instruction; a called procedure does not read them
+            memset(out, 0, words * sizeof(LocalSet));
+
+            if(!isUnconditional(ins) && i + 1 < end)
+                for(int w = 0; w < words; w++) out[w] |= in[words + w];
+
+            if(isBranch(ins) && ins->op != CAL && ins->op != LCAL && ins->m >= begin && ins->m < end)
+            {
+                LocalSet* target = live + (size_t)(ins->m - begin) * words;
+                for(int w = 0; w < words; w++) out[w] |= target[w];
+            }
+
+            int uses[2], keep;
+            int written = getLocals(locals, *ins, uses, &keep);
+
+            removed[i - begin] = written >= 0 && !keep && !HAS_LOCAL(out, written);
+
+            if(!removed[i - begin])
+            {
+                if(written >= 0) REMOVE_LOCAL(out, written);
+                if(uses[0] >= 0) ADD_LOCAL(out, uses[0]);
+                if(uses[1] >= 0) ADD_LOCAL(out, uses[1]);
+            }
+
+            if(memcmp(in, out, words * sizeof(LocalSet)))
+            {
+                memcpy(in, out, words * sizeof(LocalSet));
+                changed = 1;
+            }
+        }
+    }
+
+    free(out);
+}
+
+int eliminateDeadStores(Instruction* code, int begin, int end, int firstLocal, int numberOfSlots, int* addresses)
+{
+    int n = end - begin;
+
+    if(n <= 0) return end;
+
+    int count = REGISTER_FILE_REG_COUNT + (numberOfSlots > firstLocal ? numberOfSlots - firstLocal : 0);
+    Locals locals = { firstLocal, numberOfSlots, (count + LOCAL_SET_BITS - 1) / LOCAL_SET_BITS };
+
+    char* removed = malloc(n);
+    LocalSet* live = malloc((size_t)n * locals.words * sizeof(LocalSet));
+
+    computeLiveness(&locals, code, begin, end, removed, live);
+
+    // The new address of each instruction, a removed one gets the next kept one
+    int* map = addresses ? addresses : malloc((end + 1) * sizeof(int));
+
+    if(addresses)
+        for(int i = 0; i < begin; i++) map[i] = i;
+
+    int kept = begin;
+    for(int i = begin; i < end; i++)
+    {
+        map[i] = kept;
+        if(!removed[i - begin]) kept++;
+    }
+    map[end] = kept;
+
+    // Move the instructions kept to their new addresses, relocating the branches within the code
+    for(int i = begin; i < end; i++)
+    {
+        if(removed[i - begin]) continue;
+
+        code[map[i]] = code[i];
+
+        Instruction* ins = &code[map[i]];
+        if(isBranch(ins) && ins->m >= begin && ins->m <= end) ins->m = map[ins->m];
+    }
+
+    if(map != addresses) free(map);
+    free(removed);
+    free(live);
+
+    return kept;
+}
@@ -0,0 +1,59 @@
+#ifndef __OPTIMIZER_H__
+#define __OPTIMIZER_H__
+
+#include "data.h"
+
+/**
+ * Optimization passes over the generated code, except for those set in the
+ * disabledPasses of the options of the code generator. Dead store
+ * elimination runs on the code of each block as soon as it is generated.
+ * After a successful code generation, jump threading runs on the code of the
+ * whole program.
+ * */
+typedef enum {
+    PASS_JUMP_THREADING = 1 << 0,
+    PASS_DEAD_STORE_ELIMINATION = 1 << 1
+} OptimizationPass;
+
+/**
+ * Dead store elimination on the statement of a block, the code from begin
+ * to end, which ends with its RTN and does not branch outside of itself
+ * except for calls.
+ *
+ * The registers and the slots of the activation record of the block from
+ * firstLocal to numberOfSlots, its variables that no nested procedure
+ * accesses, are local to the code: a called procedure does not read them,
+ * and none of them is live after the RTN. Their liveness is computed along the
+ * control flow, and the instructions that write only a local that is not
+ * read afterwards are removed, such as the STO of a variable assigned before
+ * the block returns, and so are those computing the values that only they
+ * read. Instructions with side effects (input and output, calls, stores
+ * that are not local and divisions that could divide by zero) are kept.
+ *
+ * Returns the new end of the code. If addresses is not NULL, it has room for
+ * end + 1 entries and is filled with the new address of each instruction as
+ * threadJumps() does, the instructions before begin keeping theirs.
+ * */
+int eliminateDeadStores(Instruction* code, int begin, int end, int firstLocal, int numberOfSlots, int* addresses);
+
+/**
+ * Jump threading. Collapses the chains of branches:
+ *
+ *   - A branch, CAL or LCAL whose target is a JMP is retargeted to the final
+ *     destination of the chain of JMPs.
+ *   - A compare and branch over a JMP, which is "JLT a; JMP b; a:", becomes
+ *     the opposite compare and branch to b, "JGE b; a:". A JPC over a JMP
+ *     becomes a single JPC to b after the compare before it is replaced by
+ *     the opposite compare. The result of a compare is assumed to be read by
+ *     the JPC that follows it only.
+ *   - The JMPs to the next instruction and the JMPs that are not reached by
+ *     any branch nor by the instruction before them are removed.
+ *
+ * Returns the number of instructions left. If addresses is not NULL, it has
+ * room for numberOfInstructions + 1 entries and is filled with the new address
+ * of each instruction, including the end of the code. A removed instruction
+ * gets the address of the instruction that replaced it, the next one kept.
+ * */
+int threadJumps(Instruction* code, int numberOfInstructions, int* addresses);
+
+#endif
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "token.h"
+#include "code_generator.h"
+#include "vm/execute.h"
+
+/**
+ * Compiles a token list and runs the generated code in a single process. The
+ * instructions are handed to the virtual machine in memory, instead of being
+ * written by code_generator.out and read back by vm.out.
+ * */
+
+static void printUsage()
+{
+    fprintf(stderr, "Usage: ./compile_and_run.out [-o cg_output_file] [-s stack_height] [-j] (pl0_lexer_out) [vm_inp_file=stdin] [vm_outp_file=stdout]\n");
+
+    fprintf(stderr, "\n       cg_output_file: Also write the code generator output to this file, as code_generator.out does.\n");
+
+    fprintf(stderr, "\n       stack_height: The number of slots of the stack of the virtual machine, see vm.out.\n");
+
+    fprintf(stderr, "\n       -j: Translate the instructions to native code before running them, see vm.out.\n");
+
+    fprintf(stderr, "\n       pl0_lexer_out: The path to the file containing the lexer out for the programming language PL/0.\n");
+
+    fprintf(stderr, "\n       vm_inp_file, vm_outp_file: The files attached to the input and the output of the PL/0 program. Use dash ('-') for stdin and stdout.\n");
+}
+
+int main(int argc, char** argv)
+{
+    const char* cgOutPath = NULL;
+    int stackHeight = 0;
+    int jit = 0;
+    int argi = 1;
+
+    // Options precede the file arguments
+    while(argi < argc && argv[argi][0] == '-' && argv[argi][1] != '\0')
+    {
+        if( !strcmp(argv[argi], "-o") && argi + 1 < argc )
+        {
+            cgOutPath = argv[argi + 1];
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-s") && argi + 1 < argc )
+        {
+            stackHeight = atoi(argv[argi + 1]);
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-j") )
+        {
+            jit = 1;
+            argi++;
+        }
+        else
+        {
+            printUsage();
+            return -1;
+        }
+    }
+
+    // Shift the options out of the arguments
+    argc -= argi - 1;
+    argv += argi - 1;
+
+    if(argc < 2 || argc > 4)
+    {
+        printUsage();
+        return -1;
+    }
+
+    FILE* inp = fopen(argv[1], "r");
+    FILE* vm_inp = argc > 2 && strcmp(argv[2], "-") ? fopen(argv[2], "r") : stdin;
+    FILE* vm_outp = argc > 3 && strcmp(argv[3], "-") ? fopen(argv[3], "w") : stdout;
+    FILE* cgOut = cgOutPath ? fopen(cgOutPath, "w") : NULL;
+
+    if(!inp || !vm_inp || !vm_outp || (cgOutPath && !cgOut))
+    {
+        fprintf(stderr, "Could not open \"%s\"\n", !inp ? argv[1] : !vm_inp ? argv[2] : !vm_outp ? argv[3] : cgOutPath);
+        return -1;
+    }
+
+    TokenList tokenList = readTokenList(inp);
+    fclose(inp);
+
+    CodeGenContext* ctx = createCodeGenContext();
+
+    int err = compileTokenList(ctx, &tokenList, NULL);
+
+    if(cgOut)
+    {
+        if(err) printCGErr(err, cgOut);
+        else    printGeneratedCode(ctx, cgOut);
+
+        fclose(cgOut);
+    }
+
+    int result = EXECUTE_HALTED;
+
+    if(err) printCGErr(err, stderr);
+    else
+    {
+        int numberOfInstructions;
+        Instruction* code = getInstructions(ctx, &numberOfInstructions);
+
+        result = executeInstructions(code, numberOfInstructions, stackHeight, jit, vm_inp, vm_outp);
+
+        if(result == EXECUTE_FAILED_VERIFICATION) fprintf(stderr, "VM cannot run code that failed verification\n");
+        if(result == EXECUTE_STACK_OVERFLOW)      fprintf(stderr, "VM stack overflow\n");
+        if(result == EXECUTE_NO_MEMORY)           fprintf(stderr, "VM cannot allocate its stack\n");
+    }
+
+    destroyCodeGenContext(ctx);
+    deleteTokenList(&tokenList);
+
+    if(vm_inp != stdin) fclose(vm_inp);
+    if(vm_outp != stdout) fclose(vm_outp);
+
+    return err || result != EXECUTE_HALTED ? -1 : 0;
+}
@@ -0,0 +1,188 @@
+#define _GNU_SOURCE
+#include "server.h"
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "token.h"
+
+/**
+ * Set by the SIGINT and SIGTERM handler to stop accepting connections.
+ * */
+static volatile sig_atomic_t stopped = 0;
+
+/**
+ * Largest lexer output accepted in a request, see server.h.
+ * */
+#define MAX_REQUEST_LENGTH (16ul << 20)
+
+static void stop(int signal)
+{
+    (void)signal;
+    stopped = 1;
+}
+
+typedef struct {
+    int socket;
+    CodeGeneratorOptions options;
+} Connection;
+
+/**
+ * Compiles the lexer output in input[0, length) and writes the response to
+ * the given stream. Returns -1 if the response could not be written.
+ * */
+static int respond(CodeGenContext* ctx, const CodeGeneratorOptions* options, char* input, size_t length, FILE* out)
+{
+    // readTokenList() seeks over the header, therefore needs a seekable stream
+    FILE* inp = fmemopen(input, length, "r");
+    TokenList tokenList = readTokenList(inp);
+    if(inp) fclose(inp);
+
+    int err = compileTokenList(ctx, &tokenList, options);
+
+    deleteTokenList(&tokenList);
+
+    // The output is buffered to send its length first
+    char* output = NULL;
+    size_t outputLength = 0;
+    FILE* outp = open_memstream(&output, &outputLength);
+
+    if(err) printCGErr(err, outp);
+    else    printGeneratedCode(ctx, outp);
+
+    fclose(outp);
+
+    int written = fprintf(out, "%d %zu\n", err, outputLength) > 0 &&
+                  fwrite(output, 1, outputLength, out) == outputLength &&
+                  fflush(out) == 0;
+
+    free(output);
+
+    return written ? 0 : -1;
+}
+
+static void* serveConnection(void* arg)
+{
+    Connection* connection = arg;
+    CodeGenContext* ctx = createCodeGenContext();
+
+    FILE* in = fdopen(connection->socket, "r");
+    FILE* out = fdopen(dup(connection->socket), "w");
+
+    // The request buffer is reused by the requests of the connection
+    char* input = NULL;
+    size_t capacity = 0;
+
+    char header[64];
+    while( in && out && fgets(header, sizeof(header), in) )
+    {
+        char* end;
+        unsigned long length = strtoul(header, &end, 10);
+        if(end == header || *end != '\n' || length > MAX_REQUEST_LENGTH) break;
+
+        if(length + 1 > capacity)
+        {
+            char* grown = realloc(input, length + 1);
+            if(!grown) break;
+
+            input = grown;
+            capacity = length + 1;
+        }
+
+        if( fread(input, 1, length, in) != length ) break;
+        input[length] = '\0';
+
+        if( respond(ctx, &connection->options, input, length, out) ) break;
+    }
+
+    free(input);
+
+    if(in)  fclose(in);
+    if(out) fclose(out);
+
+    destroyCodeGenContext(ctx);
+    free(connection);
+
+    return NULL;
+}
+
+int runServer(const char* socketPath, const CodeGeneratorOptions* options)
+{
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+
+    if(strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Socket path \"%s\" is too long\n", socketPath);
+        return -1;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listener < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+
+    // A socket left behind by a previous server would fail bind()
+    unlink(socketPath);
+
+    if( bind(listener, (struct sockaddr*)&address, sizeof(address)) || listen(listener, 64) )
+    {
+        fprintf(stderr, "Could not listen on \"%s\": %s\n", socketPath, strerror(errno));
+        close(listener);
+        return -1;
+    }
+
+    /**
+     * The handlers are installed without SA_RESTART, so that accept() is
+     * interrupted by the signals. Writes to closed connections fail with
+     * EPIPE instead of terminating the server.
+     * */
+    struct sigaction action = { .sa_handler = stop };
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // The connection threads would share the side-file and the counters
+    CodeGeneratorOptions connectionOptions = *options;
+    connectionOptions.symbols = NULL;
+    connectionOptions.metrics = NULL;
+    connectionOptions.stats = NULL;
+
+    while(!stopped)
+    {
+        int client = accept(listener, NULL, NULL);
+        if(client < 0)
+        {
+            if(errno == EINTR || errno == ECONNABORTED) continue;
+
+            perror("accept");
+            break;
+        }
+
+        Connection* connection = malloc(sizeof(Connection));
+        *connection = (Connection){ .socket = client, .options = connectionOptions };
+
+        pthread_t thread;
+        if( pthread_create(&thread, NULL, serveConnection, connection) )
+        {
+            close(client);
+            free(connection);
+            continue;
+        }
+
+        pthread_detach(thread);
+    }
+
+    close(listener);
+    unlink(socketPath);
+
+    return 0;
+}
@@ -0,0 +1,35 @@
+#ifndef __SERVER_H__
+#define __SERVER_H__
+
+#include "code_generator.h"
+
+/**
+ * Runs the code generator as a server listening on the Unix domain socket at
+ * socketPath, until SIGINT or SIGTERM is received. Compilations are done with
+ * the given options, except options->symbols, options->metrics and
+ * options->stats, which are ignored.
+ *
+ * Each connection is served by a thread of its own, which keeps a single
+ * CodeGenContext for all the requests of the connection. Therefore, the code
+ * array and the symbol table are allocated once per connection and reused by
+ * the following compilations.
+ *
+ * A connection carries any number of requests, each answered before the next
+ * one is read:
+ *
+ *   request : <length>\n<length bytes of pl0_lexer_out>
+ *   response: <error code> <length>\n<length bytes of cg_output>
+ *
+ * where the response bytes are the same as code_generator.out writes to the
+ * cg_output_file for the given lexer output, and error code is 0 if the code
+ * generation was successful.
+ *
+ * A connection is closed without a response if its request header is
+ * malformed, if length exceeds 16 MiB or if the request could not be
+ * buffered. The other connections are served as usual.
+ *
+ * Returns 0 when stopped by a signal, -1 if the socket could not be set up.
+ * */
+int runServer(const char* socketPath, const CodeGeneratorOptions* options);
+
+#endif
@@ -6,6 +6,9 @@ void initSymbolTable(SymbolTable* symbolTable)
 {
     symbolTable->symbols = NULL;
     symbolTable->numberOfSymbols = 0;
+    symbolTable->capacity = 0;
+    symbolTable->lookups = 0;
+    symbolTable->probes = 0;
 }
 
 void deleteSymbolTable(SymbolTable* symbolTable)
@@ -17,6 +20,16 @@ void deleteSymbolTable(SymbolTable* symbolTable)
 
     symbolTable->symbols = NULL;
     symbolTable->numberOfSymbols = 0;
+    symbolTable->capacity = 0;
+}
+
+void clearSymbolTable(SymbolTable* symbolTable)
+{
+    if(!symbolTable) return;
+
+    symbolTable->numberOfSymbols = 0;
+    symbolTable->lookups = 0;
+    symbolTable->probes = 0;
 }
 
 Symbol* addSymbol(SymbolTable* symbolTable, Symbol symbol)
@@ -25,7 +38,12 @@ Symbol* addSymbol(SymbolTable* symbolTable, Symbol symbol)
 
     symbolTable->numberOfSymbols++;
 
-    symbolTable->symbols = (Symbol*)realloc(symbolTable->symbols, (symbolTable->numberOfSymbols) * sizeof(Symbol));
+    // Grow by doubling, the memory is kept by clearSymbolTable()
+    if(symbolTable->numberOfSymbols > symbolTable->capacity)
+    {
+        symbolTable->capacity = symbolTable->capacity ? 2 * symbolTable->capacity : 16;
+        symbolTable->symbols = (Symbol*)realloc(symbolTable->symbols, symbolTable->capacity * sizeof(Symbol));
+    }
 
     symbolTable->symbols[symbolTable->numberOfSymbols - 1] = symbol;
 
@@ -88,12 +106,16 @@ Symbol* findSymbol(SymbolTable* symbolTable, Symbol* scope, const char* symbolNa
 {
     if(!symbolTable || !symbolName) return NULL;
 
+    symbolTable->lookups++;
+
     // Search from the most inner scope to global scope
     while(1)
     {
         // Search the current scope
         for(int i = 0; i < symbolTable->numberOfSymbols; i++)
         {
+            symbolTable->probes++;
+
             if( symbolTable->symbols[i].scope == scope && !strcmp(symbolTable->symbols[i].name, symbolName) )
             {
                 return &symbolTable->symbols[i];
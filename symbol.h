@@ -22,6 +22,12 @@ typedef enum
  * level  : CONST, VAR, PROC
  * address: VAR, PROC
  * scope  : CONST, VAR, PROC
+ * reg    : VAR, PROC
+ *
+ * The address of a VAR is the slot of the variable in the activation record of
+ * its scope, 0 until one is given. reg is the register that holds a variable
+ * that is kept in a register instead, or -1. For a PROC, reg is the link
+ * register of a leaf procedure called with LCAL, or -1.
  * */
 
 typedef struct Symbol Symbol;
@@ -33,6 +39,7 @@ struct Symbol {
 	unsigned int level;
     unsigned int address;
     Symbol* scope;
+    int reg;
 };
 
 /**
@@ -41,6 +48,13 @@ struct Symbol {
 typedef struct {
     Symbol* symbols;
     int numberOfSymbols;
+
+    // Number of symbols the symbols array has room for
+    int capacity;
+
+    // Number of findSymbol() calls, and the symbols they compared with the name
+    long lookups;
+    long probes;
 } SymbolTable;
 
 /**
@@ -54,6 +68,12 @@ void initSymbolTable(SymbolTable*);
  * */
 void deleteSymbolTable(SymbolTable*);
 
+/**
+ * Removes the symbols of the given symbol table, but keeps its memory to be
+ * reused by the next symbols added. The lookups and probes are reset.
+ * */
+void clearSymbolTable(SymbolTable*);
+
 /**
  * Appends a copy of the given symbol to the given symbol table.
  * */
@@ -0,0 +1,193 @@
+#!/bin/bash
+# Grades the test cases of tests.txt like grader.sh does, but runs the cases
+# on all the processors at the same time and skips the cases that are
+# unchanged since they were last run.
+#
+# A case is unchanged if its line in tests.txt, its input files, its expected
+# output and the code generator and virtual machine binaries are all the same.
+# Its result and its outputs are then taken from the cache directory.
+#
+# Usage: ./parallel_grader.sh [-j jobs] [-c cache_dir] [-n] [-s slowest] [-p]
+#   -j jobs     : The number of cases run at the same time, defaults to the
+#                 number of processors.
+#   -c cache_dir: The directory of the cached results, .grade_cache by default.
+#   -n          : Run every case, without looking up or storing the cache.
+#   -s slowest  : The number of slowest cases listed at the end, 5 by default.
+#   -p          : Compile and run each case in a single process with
+#                 compile_and_run.out, instead of code_generator.out and vm.out.
+tests="tests.txt"
+cg="../code_generator.out"
+vm="../vm/vm.out"
+runner=""
+EMPH='\033[1;31m'
+GREEN_EMPH='\033[1;32m'
+DEEMPH='\033[0m'
+timeout=1s
+
+jobs=$(nproc)
+cache_dir=".grade_cache"
+use_cache=1
+slowest=5
+
+while getopts "j:c:ns:p" opt; do
+    case $opt in
+      j) jobs=$OPTARG ;;
+      c) cache_dir=$OPTARG ;;
+      n) use_cache=0 ;;
+      s) slowest=$OPTARG ;;
+      p) runner="../compile_and_run.out" ;;
+      *) echo "Usage: $0 [-j jobs] [-c cache_dir] [-n] [-s slowest] [-p]"; exit 1 ;;
+    esac
+done
+
+# check if cg.out, vm.out and tests_grader.txt exists
+if [[ -n $runner && ! -e $runner ]] ; then
+    echo "$runner could not be found! Aborting.."
+    exit
+elif [[ -e $cg && -e $vm && -e $tests ]] ; then
+    echo "$cg, $vm and $tests are found. Starting tests on $jobs jobs.."
+else
+    echo "$cg, $vm or $tests could not be found! Aborting.."
+    exit
+fi
+
+# Results of the cases, one file per case named after its index
+results=$(mktemp -d)
+trap 'rm -rf "$results"' EXIT
+
+mkdir -p "$cache_dir"
+
+# The binaries are hashed once, as a part of the key of every case
+binaries_hash=$(cat "$cg" "$vm" $runner | sha256sum | cut -d' ' -f1)
+
+# Runs the case at the given index, and writes "result milliseconds cached"
+# to its file in the results directory.
+run_case() {
+    local i=$1
+    local is_err cg_in cg_out others vm_inp vm_out gt_out
+    read is_err cg_in cg_out others <<< "$(sed -n "$((i + 1))p" "$tests")"
+
+    # resolve others depending on whether it is an error case or not
+    if [ "$is_err" = "not_error" ]; then
+      read vm_inp vm_out gt_out <<< "$others"
+    elif [ "$is_err" = "error" ]; then
+      vm_inp=/dev/null
+      vm_out=""
+      gt_out=$others
+    else
+      echo "ERROR 0 0" > "$results/$i"
+      return
+    fi
+
+    local key entry
+    key=$( { echo "$binaries_hash $is_err $cg_in $cg_out $others"; cat "$cg_in" "$vm_inp" "$gt_out"; } 2>/dev/null | sha256sum | cut -d' ' -f1 )
+    entry="$cache_dir/$key"
+
+    # create directories if needed
+    mkdir -p "$(dirname "$cg_out")"
+    [ -n "$vm_out" ] && mkdir -p "$(dirname "$vm_out")"
+
+    # Restore the outputs of an unchanged case
+    if [[ $use_cache = 1 && -e $entry/result ]] ; then
+      cp "$entry/cg_out" "$cg_out"
+      [ -n "$vm_out" ] && cp "$entry/vm_out" "$vm_out"
+      echo "$(cat "$entry/result") 1" > "$results/$i"
+      return
+    fi
+
+    local start end _diff result
+    start=$(date +%s%N)
+
+    if [ -n "$runner" ]; then
+      # compile and run in a single process, which writes no vm_out on errors
+      (timeout $timeout "$runner" -o "$cg_out" "$cg_in" "$vm_inp" "${vm_out:-/dev/null}") > /dev/null 2>&1
+    else
+      # run the code generator
+      (timeout $timeout "$cg" "$cg_in" "$cg_out") > /dev/null 2>&1
+    fi
+
+    # if the error case is expected, then, do not run vm but just check the err
+    if [ "$is_err" = "error" ]; then
+      _diff=$( { diff -B -w "$cg_out" "$gt_out"; } 2>&1 )
+    else
+      [ -z "$runner" ] && (timeout $timeout "$vm" "$cg_out" "/dev/null" "$vm_inp" "$vm_out") > /dev/null 2>&1
+      _diff=$( { diff -B -w "$vm_out" "$gt_out"; } 2>&1 )
+    fi
+
+    end=$(date +%s%N)
+
+    if [[ $_diff ]] ; then result=FAILED; else result=PASSED; fi
+    echo "$result $(( (end - start) / 1000000 ))" > "$results/$i.run"
+
+    # Store the result and the outputs, renaming the entry into place at once
+    if [ $use_cache = 1 ]; then
+      local tmp="$cache_dir/.tmp.$$.$i"
+      mkdir -p "$tmp"
+      cp "$cg_out" "$tmp/cg_out" 2>/dev/null || : > "$tmp/cg_out"
+      [ -n "$vm_out" ] && { cp "$vm_out" "$tmp/vm_out" 2>/dev/null || : > "$tmp/vm_out"; }
+      cp "$results/$i.run" "$tmp/result"
+      mv -T "$tmp" "$entry" 2>/dev/null || rm -rf "$tmp"
+    fi
+
+    echo "$(cat "$results/$i.run") 0" > "$results/$i"
+    rm -f "$results/$i.run"
+}
+
+export -f run_case
+export tests cg vm runner timeout cache_dir use_cache results binaries_hash
+
+n=$(grep -c . "$tests")
+wall_start=$(date +%s%N)
+
+seq 0 $((n - 1)) | xargs -P "$jobs" -I{} bash -c 'run_case {}'
+
+wall_end=$(date +%s%N)
+
+passed=0
+failed=0
+cached=0
+
+for (( i = 0; i < n; i++ )); do
+    read result ms from_cache < "$results/$i"
+
+    if [ "$from_cache" = "1" ]; then
+      let cached=$cached+1
+      timing="(cached)"
+    else
+      timing="$ms ms"
+    fi
+
+    if [ "$result" = "PASSED" ]; then
+      # yay! test passed
+      echo -e "${GREEN_EMPH}TEST[$i]${DEEMPH} PASSED $timing"
+      let passed=$passed+1
+    else
+      # sad.. difference found
+      read is_err cg_in cg_out others <<< "$(sed -n "$((i + 1))p" "$tests")"
+      echo -e "${GREEN_EMPH}TEST[$i]${DEEMPH} ${EMPH}FAILED${DEEMPH} $timing"
+      echo "  (cd test/; ./$cg $cg_in $cg_out)"
+      if [ "$is_err" = "not_error" ]; then
+        read vm_inp vm_out gt_vm_out <<< "$others"
+        echo "  (cd test/; ./$vm $cg_out /dev/null $vm_inp $vm_out)"
+        echo "  The output in \"test/$vm_out\" was expected to match \"test/$gt_vm_out\"."
+      else
+        echo "  The output in \"test/$cg_out\" was expected to match \"test/$others\"."
+      fi
+      let failed=$failed+1
+    fi
+
+    [ "$from_cache" != "1" ] && echo "$ms $i" >> "$results/timings"
+done
+
+echo "# of tests       : $n"
+echo "# of tests passed: $passed"
+echo "# of tests failed: $failed"
+echo "# of tests cached: $cached"
+echo "wall time        : $(( (wall_end - wall_start) / 1000000 )) ms on $jobs jobs"
+
+if [[ -s $results/timings && $slowest -gt 0 ]] ; then
+    echo "slowest tests    :"
+    sort -rn "$results/timings" | head -n "$slowest" | while read ms i; do
+      echo "  TEST[$i] $ms ms"
+    done
+fi
@@ -0,0 +1,188 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../token.h"
+#include "../code_generator.h"
+
+/**
+ * Compiles the token lists of tests.txt on a single thread, and then
+ * concurrently on many threads, each with its own CodeGenContext. Every
+ * concurrent compilation is expected to give the same error code and the
+ * same instructions as the single threaded one.
+ *
+ * Usage: ./stress_test.out [threads] [rounds]
+ * */
+
+#define DEFAULT_THREADS 8
+#define DEFAULT_ROUNDS 200
+
+typedef struct {
+    char name[256];
+    TokenList tokenList;
+
+    // Result of the single threaded compilation
+    int err;
+    Instruction* code;
+    int numberOfInstructions;
+} Program;
+
+typedef struct {
+    Program* programs;
+    int numberOfPrograms;
+    int rounds;
+    int id;
+    int mismatches;
+} Worker;
+
+/**
+ * Reads the token lists, which are the second fields of the lines of
+ * tests.txt.
+ * */
+static int readPrograms(const char* tests, Program** programs)
+{
+    FILE* in = fopen(tests, "r");
+    if(!in) return -1;
+
+    int n = 0;
+    char line[4096];
+
+    while( fgets(line, sizeof(line), in) )
+    {
+        char name[256];
+        if( sscanf(line, "%*s %255s", name) != 1 ) continue;
+
+        FILE* inp = fopen(name, "r");
+        if(!inp) continue;
+
+        *programs = realloc(*programs, (n + 1) * sizeof(Program));
+        strcpy((*programs)[n].name, name);
+        (*programs)[n].tokenList = readTokenList(inp);
+        n++;
+
+        fclose(inp);
+    }
+
+    fclose(in);
+
+    return n;
+}
+
+static int sameCode(Program* program, int err, Instruction* code, int numberOfInstructions)
+{
+    if(err != program->err || numberOfInstructions != program->numberOfInstructions) return 0;
+
+    return !memcmp(code, program->code, numberOfInstructions * sizeof(Instruction));
+}
+
+static void* runWorker(void* arg)
+{
+    Worker* worker = arg;
+    CodeGenContext* ctx = createCodeGenContext();
+
+    for(int round = 0; round < worker->rounds; round++)
+    {
+        // Every worker visits the programs in a different order
+        for(int i = 0; i < worker->numberOfPrograms; i++)
+        {
+            Program* program = &worker->programs[(i + worker->id + round) % worker->numberOfPrograms];
+
+            int numberOfInstructions;
+            int err = compileTokenList(ctx, &program->tokenList, NULL);
+            Instruction* code = getInstructions(ctx, &numberOfInstructions);
+
+            if( !sameCode(program, err, code, numberOfInstructions) ) worker->mismatches++;
+        }
+    }
+
+    destroyCodeGenContext(ctx);
+
+    return NULL;
+}
+
+int main(int argc, char** argv)
+{
+    int numberOfThreads = argc > 1 ? atoi(argv[1]) : DEFAULT_THREADS;
+    int rounds = argc > 2 ? atoi(argv[2]) : DEFAULT_ROUNDS;
+
+    if(numberOfThreads < 1) numberOfThreads = 1;
+
+    Program* programs = NULL;
+    int numberOfPrograms = readPrograms("tests.txt", &programs);
+
+    if(numberOfPrograms <= 0)
+    {
+        fprintf(stderr, "Could not read the token lists of tests.txt\n");
+        return -1;
+    }
+
+    /**********************************/
+    /****  Single threaded results  ***/
+    /**********************************/
+    CodeGenContext* ctx = createCodeGenContext();
+    int failed = 0;
+
+    for(int i = 0; i < numberOfPrograms; i++)
+    {
+        Program* program = &programs[i];
+        Instruction* code;
+
+        program->err = compileTokenList(ctx, &program->tokenList, NULL);
+        code = getInstructions(ctx, &program->numberOfInstructions);
+
+        program->code = malloc((program->numberOfInstructions + 1) * sizeof(Instruction));
+        memcpy(program->code, code, program->numberOfInstructions * sizeof(Instruction));
+
+        // A program that does not fit in the code limit fails without exiting
+        if(program->numberOfInstructions > 1)
+        {
+            CodeGeneratorOptions options = { .target = TARGET_PM0, .symbols = NULL, .maxCodeLength = program->numberOfInstructions - 1 };
+            int numberOfInstructions;
+
+            int err = compileTokenList(ctx, &program->tokenList, &options);
+            getInstructions(ctx, &numberOfInstructions);
+
+            if(err != 20 || numberOfInstructions != 0)
+            {
+                printf("%s: expected error 20 with a limit of %d instructions, got %d\n", program->name, options.maxCodeLength, err);
+                failed = 1;
+            }
+        }
+    }
+
+    destroyCodeGenContext(ctx);
+
+    /**********************************/
+    /****  Concurrent compilations  ***/
+    /**********************************/
+    Worker* workers = malloc(numberOfThreads * sizeof(Worker));
+    pthread_t* threads = malloc(numberOfThreads * sizeof(pthread_t));
+
+    for(int t = 0; t < numberOfThreads; t++)
+    {
+        workers[t] = (Worker){ .programs = programs, .numberOfPrograms = numberOfPrograms, .rounds = rounds, .id = t, .mismatches = 0 };
+        pthread_create(&threads[t], NULL, runWorker, &workers[t]);
+    }
+
+    int mismatches = 0;
+    for(int t = 0; t < numberOfThreads; t++)
+    {
+        pthread_join(threads[t], NULL);
+        mismatches += workers[t].mismatches;
+    }
+
+    printf("%d compilations of %d programs on %d threads: %d mismatches\n",
+        numberOfThreads * rounds * numberOfPrograms, numberOfPrograms, numberOfThreads, mismatches);
+
+    for(int i = 0; i < numberOfPrograms; i++)
+    {
+        deleteTokenList(&programs[i].tokenList);
+        free(programs[i].code);
+    }
+
+    free(programs);
+    free(workers);
+    free(threads);
+
+    return (mismatches || failed) ? -1 : 0;
+}
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../token.h"
+#include "../code_generator.h"
+#include "../vm/verifier.h"
+
+/**
+ * Verifies hand-written PM/0 programs that the verifier is expected to accept
+ * or reject, then the code generated for the valid programs of tests.txt,
+ * for both the PM/0 and the three-address targets, which is expected to be
+ * accepted.
+ *
+ * Usage: ./verifier_test.out
+ * */
+
+#define MAX_CASE_LENGTH 16
+
+typedef struct {
+    const char* name;
+    int accepted;
+    int numberOfInstructions;
+    Instruction code[MAX_CASE_LENGTH];
+} Case;
+
+static const Case cases[] = {
+    { "procedure reading a variable of the main block", 1, 8, {
+        { JMP, 0, 0, 4 }, { LOD, 0, 1, 4 }, { SIO_WRITE, 0, 0, 1 }, { RTN, 0, 0, 0 },
+        { INC, 0, 0, 5 }, { CAL, 0, 0, 1 }, { SIO_HALT, 0, 0, 3 }, { RTN, 0, 0, 0 } } },
+
+    { "STO to the static link", 0, 10, {
+        { JMP, 0, 0, 7 }, { INC, 0, 0, 4 }, { LIT, 0, 0, 100000000 }, { STO, 0, 0, 1 },
+        { LOD, 0, 1, 4 }, { SIO_WRITE, 0, 0, 1 }, { RTN, 0, 0, 0 },
+        { INC, 0, 0, 5 }, { CAL, 0, 0, 1 }, { SIO_HALT, 0, 0, 3 } } },
+
+    { "STO to the dynamic link", 0, 4, {
+        { LIT, 0, 0, 7 }, { STO, 0, 0, 2 }, { RTN, 0, 0, 0 }, { SIO_HALT, 0, 0, 3 } } },
+
+    { "STO to the return address", 0, 3, {
+        { LIT, 0, 0, 99 }, { STO, 0, 0, 3 }, { RTN, 0, 0, 0 } } },
+
+    { "three-address destination in the header", 0, 2, {
+        { MOV3, MAKE_OPERAND(OPERAND_VARIABLE, 2), MAKE_OPERAND(OPERAND_CONSTANT, 7), 0 }, { RTN, 0, 0, 0 } } },
+
+    { "activation record larger than the guard", 0, 2, {
+        { INC, 0, 0, MAX_FRAME_SIZE }, { SIO_HALT, 0, 0, 3 } } },
+
+    { "LOD past the largest activation record", 0, 3, {
+        { INC, 0, 0, 4 }, { LOD, 0, 0, MAX_FRAME_SIZE }, { SIO_HALT, 0, 0, 3 } } }
+};
+
+/**
+ * Compiles the token lists of the valid programs of tests.txt, which are the
+ * second fields of its not_error lines, and verifies the generated code.
+ * Returns the number of programs whose code failed verification.
+ * */
+static int verifyGeneratedCode(CodeGeneratorTarget target)
+{
+    FILE* in = fopen("tests.txt", "r");
+    if(!in) return 1;
+
+    CodeGenContext* ctx = createCodeGenContext();
+    CodeGeneratorOptions options = { .target = target, .symbols = NULL };
+    int failed = 0;
+    char line[4096];
+
+    while( fgets(line, sizeof(line), in) )
+    {
+        char kind[32], name[256];
+        if( sscanf(line, "%31s %255s", kind, name) != 2 || strcmp(kind, "not_error") ) continue;
+
+        FILE* inp = fopen(name, "r");
+        if(!inp) continue;
+
+        TokenList tokenList = readTokenList(inp);
+        fclose(inp);
+
+        int numberOfInstructions;
+        int err = compileTokenList(ctx, &tokenList, &options);
+        Instruction* code = getInstructions(ctx, &numberOfInstructions);
+
+        if( err || verifyInstructions(code, numberOfInstructions, stdout) )
+        {
+            printf("%s: the code generated for target %d failed verification\n", name, target);
+            failed++;
+        }
+
+        deleteTokenList(&tokenList);
+    }
+
+    destroyCodeGenContext(ctx);
+    fclose(in);
+
+    return failed;
+}
+
+int main()
+{
+    int numberOfCases = (int)(sizeof(cases) / sizeof(cases[0]));
+    int failed = 0;
+
+    for(int i = 0; i < numberOfCases; i++)
+    {
+        Instruction code[MAX_CASE_LENGTH];
+        memcpy(code, cases[i].code, sizeof(code));
+
+        int accepted = !verifyInstructions(code, cases[i].numberOfInstructions, NULL);
+
+        if(accepted != cases[i].accepted)
+        {
+            printf("%s: expected to be %s\n", cases[i].name, cases[i].accepted ? "accepted" : "rejected");
+            failed++;
+        }
+    }
+
+    failed += verifyGeneratedCode(TARGET_PM0);
+    failed += verifyGeneratedCode(TARGET_TAC);
+
+    printf("%d cases and the generated code verified: %d failed\n", numberOfCases, failed);
+
+    return failed ? -1 : 0;
+}
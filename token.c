@@ -1,11 +1,15 @@
 #include "token.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#define TOKEN_HASH_PRIME 1099511628211ULL
 
 void initTokenList(TokenList* tokenList)
 {
     tokenList->tokens = NULL;
     tokenList->numberOfTokens = 0;
+    tokenList->capacity = 0;
 }
 
 void addToken(TokenList* tokenList, Token token)
@@ -13,8 +17,12 @@ void addToken(TokenList* tokenList, Token token)
     // Increase number of tokens
     tokenList->numberOfTokens++;
 
-    // Allocate space for new token
-    tokenList->tokens = (Token*)realloc(tokenList->tokens, (tokenList->numberOfTokens) * sizeof(Token));
+    // Allocate space for new token, doubling the space to keep reallocations few
+    if(tokenList->numberOfTokens > tokenList->capacity)
+    {
+        tokenList->capacity = tokenList->capacity ? 2 * tokenList->capacity : 64;
+        tokenList->tokens = (Token*)realloc(tokenList->tokens, tokenList->capacity * sizeof(Token));
+    }
 
     // Add token to the end of the list
     tokenList->tokens[tokenList->numberOfTokens - 1] = token;
@@ -24,7 +32,9 @@ TokenList getCopy(TokenList src)
 {
     TokenList copy;
     
+    copy.tokens = NULL;
     copy.numberOfTokens = src.numberOfTokens;
+    copy.capacity = src.tokens ? src.numberOfTokens : 0;
 
     if(src.tokens)
     {
@@ -54,8 +64,7 @@ TokenList readTokenList(FILE* in)
 {
     TokenList tokenList;
 
-    tokenList.tokens = NULL;
-    tokenList.numberOfTokens = 0;
+    initTokenList(&tokenList);
 
     if(!in) return tokenList;
 
@@ -64,7 +73,7 @@ TokenList readTokenList(FILE* in)
 
     Token token;
 
-    while( fscanf(in, "%10d   %12s\n", &token.id, token.lexeme) == 2 )
+    while( fscanf(in, "%10d   %11s\n", &token.id, token.lexeme) == 2 )
     {
         addToken(&tokenList, token);
     }
@@ -72,6 +81,25 @@ TokenList readTokenList(FILE* in)
     return tokenList;
 }
 
+unsigned long long hashTokens(const Token* tokens, int numberOfTokens, unsigned long long hash)
+{
+    for(int i = 0; i < numberOfTokens; i++)
+    {
+        const unsigned char* id = (const unsigned char*)&tokens[i].id;
+
+        for(size_t k = 0; k < sizeof(tokens[i].id); k++)
+            hash = (hash ^ id[k]) * TOKEN_HASH_PRIME;
+
+        // The terminating null separates the lexeme from the next token
+        size_t length = strlen(tokens[i].lexeme) + 1;
+
+        for(size_t k = 0; k < length; k++)
+            hash = (hash ^ (unsigned char)tokens[i].lexeme[k]) * TOKEN_HASH_PRIME;
+    }
+
+    return hash;
+}
+
 void deleteTokenList(TokenList* tokenList)
 {
     if(!tokenList) return;
@@ -80,6 +108,8 @@ void deleteTokenList(TokenList* tokenList)
         free(tokenList->tokens);
 
     tokenList->tokens = NULL;
+    tokenList->numberOfTokens = 0;
+    tokenList->capacity = 0;
 }
 
 
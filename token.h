@@ -20,6 +20,9 @@ typedef struct {
 typedef struct {
     Token* tokens;
     int numberOfTokens;
+
+    // Number of tokens the tokens array has room for
+    int capacity;
 } TokenList;
 
 /**
@@ -61,6 +64,14 @@ void printTokenList(TokenList, FILE*);
  * */
 TokenList readTokenList(FILE*);
 
+/**
+ * Returns the 64-bit FNV-1a hash of the ids and lexemes of the given tokens,
+ * continuing from the given hash. Pass TOKEN_HASH_BASIS to start a new hash.
+ * */
+#define TOKEN_HASH_BASIS 14695981039346656037ULL
+
+unsigned long long hashTokens(const Token* tokens, int numberOfTokens, unsigned long long hash);
+
 /**
  * Makes the necessary deallocations on the TokenList
  * */
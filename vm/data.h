@@ -13,6 +13,50 @@ typedef struct {
     int m;   // M
 } Instruction;
 
+// Opcodes
+enum {
+    LIT = 1, RTN = 2, LOD = 3, STO = 4, CAL = 5, INC = 6, JMP = 7, JPC = 8,
+
+    SIO_WRITE = 9, SIO_READ = 10, SIO_HALT = 11,
+    
+    NEG = 12, ADD = 13, SUB = 14, MUL = 15, DIV = 16, ODD = 17, MOD = 18,
+    EQL = 19, NEQ = 20, LSS = 21, LEQ = 22, GTR = 23, GEQ = 24,
+
+    // Compare and branch: jump to M if RF[R] is equal to, not equal to, ...,
+    // greater than or equal to RF[L]
+    JEQ = 25, JNE = 26, JLT = 27, JLE = 28, JGT = 29, JGE = 30,
+
+    // Immediate operand: RF[R] = RF[L] + M, ..., RF[L] / M
+    ADDI = 31, SUBI = 32, MULI = 33, DIVI = 34,
+
+    // Compare and branch with an immediate operand: jump to M if RF[R] is
+    // equal to, ..., greater than or equal to L
+    JEQI = 35, JNEI = 36, JLTI = 37, JLEI = 38, JGTI = 39, JGEI = 40,
+
+    // Three-address: R = L, R = L + M, ..., R = L / M, where R, L and M are
+    // operands, see below
+    MOV3 = 41, ADD3 = 42, SUB3 = 43, MUL3 = 44, DIV3 = 45,
+
+    // Three-address compare and branch: jump to M if operand R is equal to,
+    // ..., greater than or equal to operand L
+    JEQ3 = 46, JNE3 = 47, JLT3 = 48, JLE3 = 49, JGT3 = 50, JGE3 = 51,
+
+    // Leaf call and return: RF[R] = return address and jump to M, without an
+    // activation record; jump to RF[R]
+    LCAL = 52, LRTN = 53
+};
+
+// Operands of the three-address instructions. The low two bits tell whether
+// the rest is a register, the offset of a variable in the current activation
+// record or a constant.
+enum {
+    OPERAND_REGISTER = 0, OPERAND_VARIABLE = 1, OPERAND_CONSTANT = 2
+};
+
+#define MAKE_OPERAND(kind, value) ((int)((unsigned)(value) << 2) | (kind))
+#define OPERAND_KIND(operand)     ((operand) & 3)
+#define OPERAND_VALUE(operand)    ((operand) >> 2)
+
 /**
  * Virtual machine state holder
  * */
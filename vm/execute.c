@@ -0,0 +1,23 @@
+#include "execute.h"
+#include "machine.h"
+#include "verifier.h"
+#include "jit.h"
+
+int executeInstructions(Instruction* code, int numberOfInstructions, int stackHeight, int jit, FILE* vm_inp, FILE* vm_outp)
+{
+    if( verifyInstructions(code, numberOfInstructions, stderr) ) return EXECUTE_FAILED_VERIFICATION;
+
+    VirtualMachine* vm = createVirtualMachine(stackHeight > 0 ? stackHeight : MAX_STACK_HEIGHT);
+    if(!vm) return EXECUTE_NO_MEMORY;
+
+    JitCode* jitCode = jit && numberOfInstructions > 0 ? compileInstructions(code, numberOfInstructions) : NULL;
+
+    int result;
+    if(jitCode) result = runJitCode(jitCode, vm, vm_inp, vm_outp);
+    else        result = runVirtualMachine(vm, code, numberOfInstructions, NULL, vm_inp, vm_outp, 1, NULL);
+
+    deleteJitCode(jitCode);
+    deleteVirtualMachine(vm);
+
+    return result == VM_STACK_OVERFLOW ? EXECUTE_STACK_OVERFLOW : EXECUTE_HALTED;
+}
@@ -0,0 +1,40 @@
+#ifndef __EXECUTE_H__
+#define __EXECUTE_H__
+
+#include <stdio.h>
+#include "data.h"
+
+/**
+ * Entry point of the virtual machine for programs that generate the code in
+ * memory, such as the compile and run driver of the code generator.
+ *
+ * Only Instruction is used from data.h, which is defined the same by the
+ * data.h of the code generator. Therefore, this header could be included
+ * together with the headers of the code generator.
+ * */
+
+/**
+ * Return codes of executeInstructions()
+ * */
+enum {
+    EXECUTE_HALTED = 0,
+    EXECUTE_STACK_OVERFLOW = 1,
+    EXECUTE_FAILED_VERIFICATION = 2,
+    EXECUTE_NO_MEMORY = 3
+};
+
+/**
+ * Verifies the given code and runs it on a new virtual machine until it
+ * halts, as vm.out does when the execution history goes to /dev/null.
+ *
+ * stackHeight: The number of stack slots, MAX_STACK_HEIGHT if not positive.
+ * jit        : Non-zero to run the code translated to native code, see jit.h.
+ *              The interpreter is used if it could not be translated.
+ * vm_inp, vm_outp: Streams attached to SIO instructions.
+ *
+ * Verification errors are written to stderr. Returns one of the return codes
+ * above.
+ * */
+int executeInstructions(Instruction* code, int numberOfInstructions, int stackHeight, int jit, FILE* vm_inp, FILE* vm_outp);
+
+#endif
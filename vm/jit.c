@@ -0,0 +1,697 @@
+#include "jit.h"
+#include "machine.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/**
+ * Values returned by the translated code to runJitCode()
+ * */
+enum {
+    JIT_HALTED = 0,
+    JIT_INTERPRET = 1
+};
+
+struct JitCode {
+    /**
+     * Native address of each instruction. The translated code loads this
+     * pointer from the beginning of the struct, therefore it has to be the
+     * first member.
+     * */
+    unsigned char** addresses;
+
+    // Copy of the translated code for the instructions run by the interpreter
+    Instruction* code;
+    int numberOfInstructions;
+
+    // Executable buffer and its entry point
+    unsigned char* buffer;
+    size_t bufferSize;
+    int (*entry)(VirtualMachine*, JitCode*);
+
+    // Streams of the current run, used by the SIO callbacks
+    FILE* vm_inp;
+    FILE* vm_outp;
+};
+
+#if defined(__x86_64__)
+
+/**
+ * Growable buffer that the machine code is assembled into before it is copied
+ * to the executable mapping. Since every jump is either relative or through
+ * the address table, the code could be moved.
+ * */
+typedef struct {
+    unsigned char* bytes;
+    size_t size;
+    size_t capacity;
+
+    // Positions of rel32 fields to be patched with the address of an instruction
+    size_t* patchOffsets;
+    int* patchTargets;
+    int numberOfPatches;
+    int patchCapacity;
+} Assembler;
+
+static void emitBytes(Assembler* a, const unsigned char* bytes, size_t n)
+{
+    if(a->size + n > a->capacity)
+    {
+        a->capacity = 2 * (a->size + n);
+        a->bytes = realloc(a->bytes, a->capacity);
+    }
+
+    memcpy(a->bytes + a->size, bytes, n);
+    a->size += n;
+}
+
+#define EMIT(a, ...) do { \
+        const unsigned char bytes_[] = { __VA_ARGS__ }; \
+        emitBytes((a), bytes_, sizeof(bytes_)); \
+    } while(0)
+
+static void emit32(Assembler* a, int32_t value)
+{
+    emitBytes(a, (unsigned char*)&value, 4);
+}
+
+static void emit64(Assembler* a, uint64_t value)
+{
+    emitBytes(a, (unsigned char*)&value, 8);
+}
+
+/**
+ * Emits the rel32 field of a jump whose target is already assembled.
+ * */
+static void emitRelativeTo(Assembler* a, size_t target)
+{
+    emit32(a, (int32_t)((int64_t)target - (int64_t)(a->size + 4)));
+}
+
+/**
+ * Emits the rel32 field of a jump to the given instruction, which is patched
+ * once all instructions are assembled.
+ * */
+static void emitRelativeToInstruction(Assembler* a, int target)
+{
+    if(a->numberOfPatches == a->patchCapacity)
+    {
+        a->patchCapacity = 2 * a->patchCapacity + 16;
+        a->patchOffsets = realloc(a->patchOffsets, a->patchCapacity * sizeof(size_t));
+        a->patchTargets = realloc(a->patchTargets, a->patchCapacity * sizeof(int));
+    }
+
+    a->patchOffsets[a->numberOfPatches] = a->size;
+    a->patchTargets[a->numberOfPatches] = target;
+    a->numberOfPatches++;
+
+    emit32(a, 0);
+}
+
+/**
+ * Displacements of the fields of VirtualMachine from its address
+ * */
+#define BP_DISP   ((int32_t)offsetof(VirtualMachine, BP))
+#define SP_DISP   ((int32_t)offsetof(VirtualMachine, SP))
+#define PC_DISP   ((int32_t)offsetof(VirtualMachine, PC))
+#define RF_DISP(r) ((int32_t)(offsetof(VirtualMachine, RF) + (r) * sizeof(int)))
+
+/**
+ * Callbacks of the SIO instructions. Same formats as the interpreter.
+ * */
+static void writeValue(JitCode* jit, int value)
+{
+    fprintf(jit->vm_outp, "%d ", value);
+}
+
+static void readValue(JitCode* jit, int* target)
+{
+    fscanf(jit->vm_inp, "%d", target);
+}
+
+/**
+ * Register usage of the translated code:
+ *   rbx: VirtualMachine*     r12: JitCode*
+ *   r13: vm->stack          r14d: BP      r15d: SP
+ *   eax, ecx, edx, rsi, rdi: scratch
+ * */
+
+// eax = base pointer L static links down from BP
+static void emitBasePointer(Assembler* a, int L)
+{
+    EMIT(a, 0x44, 0x89, 0xF0);                          // mov eax, r14d
+    for(int i = 0; i < L; i++)
+    {
+        EMIT(a, 0x48, 0x63, 0xC0);                      // movsxd rax, eax
+        EMIT(a, 0x41, 0x8B, 0x84, 0x85); emit32(a, 4);  // mov eax, [r13 + rax*4 + 4]
+    }
+}
+
+// eax = RF[l], ecx = RF[m]
+static void emitLoadOperands(Assembler* a, int l, int m)
+{
+    EMIT(a, 0x8B, 0x83); emit32(a, RF_DISP(l));         // mov eax, [rbx + RF[l]]
+    EMIT(a, 0x8B, 0x8B); emit32(a, RF_DISP(m));         // mov ecx, [rbx + RF[m]]
+}
+
+// RF[r] = eax
+static void emitStoreResult(Assembler* a, int r)
+{
+    EMIT(a, 0x89, 0x83); emit32(a, RF_DISP(r));         // mov [rbx + RF[r]], eax
+}
+
+// Jump to the given instruction if (RF[r] cc RF[l])
+static void emitCompareBranch(Assembler* a, int r, int l, unsigned char jcc, int target)
+{
+    EMIT(a, 0x8B, 0x83); emit32(a, RF_DISP(r));         // mov eax, [rbx + RF[r]]
+    EMIT(a, 0x3B, 0x83); emit32(a, RF_DISP(l));         // cmp eax, [rbx + RF[l]]
+    EMIT(a, 0x0F, jcc); emitRelativeToInstruction(a, target);  // jcc target
+}
+
+// Jump to the given instruction if (RF[r] cc value)
+static void emitCompareImmediateBranch(Assembler* a, int r, int value, unsigned char jcc, int target)
+{
+    EMIT(a, 0x81, 0xBB); emit32(a, RF_DISP(r)); emit32(a, value);  // cmp dword [rbx + RF[r]], value
+    EMIT(a, 0x0F, jcc); emitRelativeToInstruction(a, target);      // jcc target
+}
+
+// RF[r] = (eax cc ecx)
+static void emitCompare(Assembler* a, int r, unsigned char setcc)
+{
+    EMIT(a, 0x39, 0xC8);                                // cmp eax, ecx
+    EMIT(a, 0x0F, setcc, 0xC0);                         // setcc al
+    EMIT(a, 0x0F, 0xB6, 0xC0);                          // movzx eax, al
+    emitStoreResult(a, r);
+}
+
+static int isRegister(int r)
+{
+    return r >= 0 && r < REGISTER_FILE_REG_COUNT;
+}
+
+// eax (reg = 0) or ecx (reg = 1) = the value of a three-address operand
+static void emitLoadOperand(Assembler* a, int operand, unsigned char reg)
+{
+    int value = OPERAND_VALUE(operand);
+
+    switch(OPERAND_KIND(operand))
+    {
+        case OPERAND_REGISTER:
+            EMIT(a, 0x8B, 0x83 | reg << 3); emit32(a, RF_DISP(value));     // mov reg, [rbx + RF[value]]
+            break;
+
+        case OPERAND_VARIABLE:
+            EMIT(a, 0x43, 0x8B, 0x84 | reg << 3, 0xB5); emit32(a, 4 * value); // mov reg, [r13 + r14*4 + 4value]
+            break;
+
+        default:
+            EMIT(a, 0xB8 + reg); emit32(a, value);                          // mov reg, value
+            break;
+    }
+}
+
+// The register or the variable of a three-address operand = eax
+static void emitStoreOperand(Assembler* a, int operand)
+{
+    int value = OPERAND_VALUE(operand);
+
+    if(OPERAND_KIND(operand) == OPERAND_REGISTER)
+    {
+        EMIT(a, 0x89, 0x83); emit32(a, RF_DISP(value));                     // mov [rbx + RF[value]], eax
+    }
+    else
+    {
+        EMIT(a, 0x43, 0x89, 0x84, 0xB5); emit32(a, 4 * value);             // mov [r13 + r14*4 + 4value], eax
+    }
+}
+
+// Jump to the given instruction if (operand x cc operand y)
+static void emitCompareOperandsBranch(Assembler* a, int x, int y, unsigned char jcc, int target)
+{
+    emitLoadOperand(a, x, 0);
+    emitLoadOperand(a, y, 1);
+    EMIT(a, 0x39, 0xC8);                                // cmp eax, ecx
+    EMIT(a, 0x0F, jcc); emitRelativeToInstruction(a, target);  // jcc target
+}
+
+static int isOperand(int operand)
+{
+    int value = OPERAND_VALUE(operand);
+
+    switch(OPERAND_KIND(operand))
+    {
+        case OPERAND_REGISTER: return isRegister(value);
+        case OPERAND_VARIABLE: return value >= 0;
+        case OPERAND_CONSTANT: return 1;
+        default:               return 0;
+    }
+}
+
+static int isDestination(int operand)
+{
+    return isOperand(operand) && OPERAND_KIND(operand) != OPERAND_CONSTANT;
+}
+
+/**
+ * Returns non-zero if the instruction has a template. Operands that the
+ * interpreter would reject or that would need a check at run time make the
+ * instruction fall back to the interpreter.
+ * */
+static int hasTemplate(Instruction ins, int numberOfInstructions)
+{
+    switch(ins.op)
+    {
+        case LIT: case JPC: case SIO_WRITE: case SIO_READ: case ODD:
+            return isRegister(ins.r) && (ins.op != JPC || (ins.m >= 0 && ins.m < numberOfInstructions));
+
+        case LOD: case STO:
+            return isRegister(ins.r) && ins.l >= 0 && ins.m >= 0;
+
+        case CAL: case JMP:
+            return ins.l >= 0 && ins.m >= 0 && ins.m < numberOfInstructions;
+
+        case RTN: case INC: case SIO_HALT:
+            return 1;
+
+        case NEG:
+            return isRegister(ins.r) && isRegister(ins.l);
+
+        case JEQ: case JNE: case JLT: case JLE: case JGT: case JGE:
+            return isRegister(ins.r) && isRegister(ins.l) && ins.m >= 0 && ins.m < numberOfInstructions;
+
+        case JEQI: case JNEI: case JLTI: case JLEI: case JGTI: case JGEI:
+            return isRegister(ins.r) && ins.m >= 0 && ins.m < numberOfInstructions;
+
+        case ADDI: case SUBI: case MULI:
+            return isRegister(ins.r) && isRegister(ins.l);
+
+        // Division by a zero constant is left to the interpreter
+        case DIVI:
+            return isRegister(ins.r) && isRegister(ins.l) && ins.m != 0;
+
+        case MOV3:
+            return isDestination(ins.r) && isOperand(ins.l);
+
+        case ADD3: case SUB3: case MUL3:
+            return isDestination(ins.r) && isOperand(ins.l) && isOperand(ins.m);
+
+        case DIV3:
+            return isDestination(ins.r) && isOperand(ins.l) && isOperand(ins.m) && ins.m != MAKE_OPERAND(OPERAND_CONSTANT, 0);
+
+        case JEQ3: case JNE3: case JLT3: case JLE3: case JGT3: case JGE3:
+            return isOperand(ins.r) && isOperand(ins.l) && ins.m >= 0 && ins.m < numberOfInstructions;
+
+        case LCAL:
+            return isRegister(ins.r) && ins.m >= 0 && ins.m < numberOfInstructions;
+
+        // The return address is checked by the dispatch
+        case LRTN:
+            return isRegister(ins.r);
+
+        case ADD: case SUB: case MUL: case DIV: case MOD:
+        case EQL: case NEQ: case LSS: case LEQ: case GTR: case GEQ:
+            return isRegister(ins.r) && isRegister(ins.l) && isRegister(ins.m);
+
+        default:
+            return 0;
+    }
+}
+
+static void emitInstruction(Assembler* a, Instruction ins, int i, size_t dispatch, size_t exit)
+{
+    switch(ins.op)
+    {
+        case LIT:
+            EMIT(a, 0xC7, 0x83); emit32(a, RF_DISP(ins.r)); emit32(a, ins.m);   // mov dword [rbx + RF[r]], M
+            break;
+
+        case RTN:
+            EMIT(a, 0x45, 0x89, 0xF7);                                          // mov r15d, r14d
+            EMIT(a, 0x41, 0xFF, 0xCF);                                          // dec r15d
+            EMIT(a, 0x44, 0x89, 0xFA);                                          // mov edx, r15d
+            EMIT(a, 0x48, 0x63, 0xD2);                                          // movsxd rdx, edx
+            EMIT(a, 0x45, 0x8B, 0xB4, 0x95); emit32(a, 12);                     // mov r14d, [r13 + rdx*4 + 12]
+            EMIT(a, 0x41, 0x8B, 0x8C, 0x95); emit32(a, 16);                     // mov ecx, [r13 + rdx*4 + 16]
+
+            // Returning from the outermost activation record halts
+            EMIT(a, 0x89, 0xC8);                                                // mov eax, ecx
+            EMIT(a, 0x44, 0x09, 0xF0);                                          // or eax, r14d
+            EMIT(a, 0x44, 0x09, 0xF8);                                          // or eax, r15d
+            EMIT(a, 0x0F, 0x85); emitRelativeTo(a, dispatch);                   // jnz dispatch
+            EMIT(a, 0x89, 0x8B); emit32(a, PC_DISP);                            // mov [rbx + PC], ecx
+            EMIT(a, 0x31, 0xC0);                                                // xor eax, eax
+            EMIT(a, 0xE9); emitRelativeTo(a, exit);                             // jmp exit
+            break;
+
+        case LOD:
+            emitBasePointer(a, ins.l);
+            EMIT(a, 0x48, 0x63, 0xC0);                                          // movsxd rax, eax
+            EMIT(a, 0x41, 0x8B, 0x84, 0x85); emit32(a, 4 * ins.m);              // mov eax, [r13 + rax*4 + 4M]
+            emitStoreResult(a, ins.r);
+            break;
+
+        case STO:
+            emitBasePointer(a, ins.l);
+            EMIT(a, 0x48, 0x63, 0xC0);                                          // movsxd rax, eax
+            EMIT(a, 0x8B, 0x8B); emit32(a, RF_DISP(ins.r));                     // mov ecx, [rbx + RF[r]]
+            EMIT(a, 0x41, 0x89, 0x8C, 0x85); emit32(a, 4 * ins.m);              // mov [r13 + rax*4 + 4M], ecx
+            break;
+
+        case CAL:
+            emitBasePointer(a, ins.l);
+            EMIT(a, 0x44, 0x89, 0xFA);                                          // mov edx, r15d
+            EMIT(a, 0x48, 0x63, 0xD2);                                          // movsxd rdx, edx
+            EMIT(a, 0x41, 0xC7, 0x84, 0x95); emit32(a, 4); emit32(a, 0);        // functional value
+            EMIT(a, 0x41, 0x89, 0x84, 0x95); emit32(a, 8);                      // static link
+            EMIT(a, 0x45, 0x89, 0xB4, 0x95); emit32(a, 12);                     // dynamic link
+            EMIT(a, 0x41, 0xC7, 0x84, 0x95); emit32(a, 16); emit32(a, i + 1);   // return address
+            EMIT(a, 0x45, 0x89, 0xFE);                                          // mov r14d, r15d
+            EMIT(a, 0x41, 0xFF, 0xC6);                                          // inc r14d
+            EMIT(a, 0xE9); emitRelativeToInstruction(a, ins.m);                 // jmp M
+            break;
+
+        case INC:
+            EMIT(a, 0x41, 0x81, 0xC7); emit32(a, ins.m);                        // add r15d, M
+            break;
+
+        case JMP:
+            EMIT(a, 0xE9); emitRelativeToInstruction(a, ins.m);                 // jmp M
+            break;
+
+        case JPC:
+            EMIT(a, 0x83, 0xBB); emit32(a, RF_DISP(ins.r)); EMIT(a, 0x00);      // cmp dword [rbx + RF[r]], 0
+            EMIT(a, 0x0F, 0x84); emitRelativeToInstruction(a, ins.m);           // je M
+            break;
+
+        case SIO_WRITE:
+            EMIT(a, 0x8B, 0xB3); emit32(a, RF_DISP(ins.r));                     // mov esi, [rbx + RF[r]]
+            EMIT(a, 0x4C, 0x89, 0xE7);                                          // mov rdi, r12
+            EMIT(a, 0x48, 0xB8); emit64(a, (uint64_t)(uintptr_t)writeValue);    // mov rax, writeValue
+            EMIT(a, 0xFF, 0xD0);                                                // call rax
+            break;
+
+        case SIO_READ:
+            EMIT(a, 0x48, 0x8D, 0xB3); emit32(a, RF_DISP(ins.r));               // lea rsi, [rbx + RF[r]]
+            EMIT(a, 0x4C, 0x89, 0xE7);                                          // mov rdi, r12
+            EMIT(a, 0x48, 0xB8); emit64(a, (uint64_t)(uintptr_t)readValue);     // mov rax, readValue
+            EMIT(a, 0xFF, 0xD0);                                                // call rax
+            break;
+
+        case SIO_HALT:
+            EMIT(a, 0xC7, 0x83); emit32(a, PC_DISP); emit32(a, i + 1);          // mov dword [rbx + PC], i + 1
+            EMIT(a, 0x31, 0xC0);                                                // xor eax, eax
+            EMIT(a, 0xE9); emitRelativeTo(a, exit);                             // jmp exit
+            break;
+
+        case NEG:
+            EMIT(a, 0x8B, 0x83); emit32(a, RF_DISP(ins.l));                     // mov eax, [rbx + RF[l]]
+            EMIT(a, 0xF7, 0xD8);                                                // neg eax
+            emitStoreResult(a, ins.r);
+            break;
+
+        case ADD:
+            emitLoadOperands(a, ins.l, ins.m);
+            EMIT(a, 0x01, 0xC8);                                                // add eax, ecx
+            emitStoreResult(a, ins.r);
+            break;
+
+        case SUB:
+            emitLoadOperands(a, ins.l, ins.m);
+            EMIT(a, 0x29, 0xC8);                                                // sub eax, ecx
+            emitStoreResult(a, ins.r);
+            break;
+
+        case MUL:
+            emitLoadOperands(a, ins.l, ins.m);
+            EMIT(a, 0x0F, 0xAF, 0xC1);                                          // imul eax, ecx
+            emitStoreResult(a, ins.r);
+            break;
+
+        case DIV:
+            emitLoadOperands(a, ins.l, ins.m);
+            EMIT(a, 0x99, 0xF7, 0xF9);                                          // cdq; idiv ecx
+            emitStoreResult(a, ins.r);
+            break;
+
+        case MOD:
+            emitLoadOperands(a, ins.l, ins.m);
+            EMIT(a, 0x99, 0xF7, 0xF9);                                          // cdq; idiv ecx
+            EMIT(a, 0x89, 0xD0);                                                // mov eax, edx
+            emitStoreResult(a, ins.r);
+            break;
+
+        case ODD:
+            EMIT(a, 0x8B, 0x83); emit32(a, RF_DISP(ins.r));                     // mov eax, [rbx + RF[r]]
+            EMIT(a, 0xB9); emit32(a, 2);                                        // mov ecx, 2
+            EMIT(a, 0x99, 0xF7, 0xF9);                                          // cdq; idiv ecx
+            EMIT(a, 0x89, 0xD0);                                                // mov eax, edx
+            emitStoreResult(a, ins.r);
+            break;
+
+        case EQL: emitLoadOperands(a, ins.l, ins.m); emitCompare(a, ins.r, 0x94); break;  // sete
+        case NEQ: emitLoadOperands(a, ins.l, ins.m); emitCompare(a, ins.r, 0x95); break;  // setne
+        case LSS: emitLoadOperands(a, ins.l, ins.m); emitCompare(a, ins.r, 0x9C); break;  // setl
+        case LEQ: emitLoadOperands(a, ins.l, ins.m); emitCompare(a, ins.r, 0x9E); break;  // setle
+        case GTR: emitLoadOperands(a, ins.l, ins.m); emitCompare(a, ins.r, 0x9F); break;  // setg
+        case GEQ: emitLoadOperands(a, ins.l, ins.m); emitCompare(a, ins.r, 0x9D); break;  // setge
+
+        case JEQ: emitCompareBranch(a, ins.r, ins.l, 0x84, ins.m); break;   // je
+        case JNE: emitCompareBranch(a, ins.r, ins.l, 0x85, ins.m); break;   // jne
+        case JLT: emitCompareBranch(a, ins.r, ins.l, 0x8C, ins.m); break;   // jl
+        case JLE: emitCompareBranch(a, ins.r, ins.l, 0x8E, ins.m); break;   // jle
+        case JGT: emitCompareBranch(a, ins.r, ins.l, 0x8F, ins.m); break;   // jg
+        case JGE: emitCompareBranch(a, ins.r, ins.l, 0x8D, ins.m); break;   // jge
+
+        case JEQI: emitCompareImmediateBranch(a, ins.r, ins.l, 0x84, ins.m); break;  // je
+        case JNEI: emitCompareImmediateBranch(a, ins.r, ins.l, 0x85, ins.m); break;  // jne
+        case JLTI: emitCompareImmediateBranch(a, ins.r, ins.l, 0x8C, ins.m); break;  // jl
+        case JLEI: emitCompareImmediateBranch(a, ins.r, ins.l, 0x8E, ins.m); break;  // jle
+        case JGTI: emitCompareImmediateBranch(a, ins.r, ins.l, 0x8F, ins.m); break;  // jg
+        case JGEI: emitCompareImmediateBranch(a, ins.r, ins.l, 0x8D, ins.m); break;  // jge
+
+        case ADDI:
+            EMIT(a, 0x8B, 0x83); emit32(a, RF_DISP(ins.l));                     // mov eax, [rbx + RF[l]]
+            EMIT(a, 0x05); emit32(a, ins.m);                                    // add eax, M
+            emitStoreResult(a, ins.r);
+            break;
+
+        case SUBI:
+            EMIT(a, 0x8B, 0x83); emit32(a, RF_DISP(ins.l));                     // mov eax, [rbx + RF[l]]
+            EMIT(a, 0x2D); emit32(a, ins.m);                                    // sub eax, M
+            emitStoreResult(a, ins.r);
+            break;
+
+        case MULI:
+            EMIT(a, 0x8B, 0x83); emit32(a, RF_DISP(ins.l));                     // mov eax, [rbx + RF[l]]
+            EMIT(a, 0x69, 0xC0); emit32(a, ins.m);                              // imul eax, eax, M
+            emitStoreResult(a, ins.r);
+            break;
+
+        case DIVI:
+            EMIT(a, 0x8B, 0x83); emit32(a, RF_DISP(ins.l));                     // mov eax, [rbx + RF[l]]
+            EMIT(a, 0xB9); emit32(a, ins.m);                                    // mov ecx, M
+            EMIT(a, 0x99, 0xF7, 0xF9);                                          // cdq; idiv ecx
+            emitStoreResult(a, ins.r);
+            break;
+
+        case MOV3:
+            emitLoadOperand(a, ins.l, 0);
+            emitStoreOperand(a, ins.r);
+            break;
+
+        case ADD3:
+            emitLoadOperand(a, ins.l, 0); emitLoadOperand(a, ins.m, 1);
+            EMIT(a, 0x01, 0xC8);                                                // add eax, ecx
+            emitStoreOperand(a, ins.r);
+            break;
+
+        case SUB3:
+            emitLoadOperand(a, ins.l, 0); emitLoadOperand(a, ins.m, 1);
+            EMIT(a, 0x29, 0xC8);                                                // sub eax, ecx
+            emitStoreOperand(a, ins.r);
+            break;
+
+        case MUL3:
+            emitLoadOperand(a, ins.l, 0); emitLoadOperand(a, ins.m, 1);
+            EMIT(a, 0x0F, 0xAF, 0xC1);                                          // imul eax, ecx
+            emitStoreOperand(a, ins.r);
+            break;
+
+        case DIV3:
+            emitLoadOperand(a, ins.l, 0); emitLoadOperand(a, ins.m, 1);
+            EMIT(a, 0x99, 0xF7, 0xF9);                                          // cdq; idiv ecx
+            emitStoreOperand(a, ins.r);
+            break;
+
+        case JEQ3: emitCompareOperandsBranch(a, ins.r, ins.l, 0x84, ins.m); break;  // je
+        case JNE3: emitCompareOperandsBranch(a, ins.r, ins.l, 0x85, ins.m); break;  // jne
+        case JLT3: emitCompareOperandsBranch(a, ins.r, ins.l, 0x8C, ins.m); break;  // jl
+        case JLE3: emitCompareOperandsBranch(a, ins.r, ins.l, 0x8E, ins.m); break;  // jle
+        case JGT3: emitCompareOperandsBranch(a, ins.r, ins.l, 0x8F, ins.m); break;  // jg
+        case JGE3: emitCompareOperandsBranch(a, ins.r, ins.l, 0x8D, ins.m); break;  // jge
+
+        case LCAL:
+            EMIT(a, 0xC7, 0x83); emit32(a, RF_DISP(ins.r)); emit32(a, i + 1);   // mov dword [rbx + RF[r]], i + 1
+            EMIT(a, 0xE9); emitRelativeToInstruction(a, ins.m);                 // jmp M
+            break;
+
+        case LRTN:
+            EMIT(a, 0x8B, 0x8B); emit32(a, RF_DISP(ins.r));                     // mov ecx, [rbx + RF[r]]
+            EMIT(a, 0xE9); emitRelativeTo(a, dispatch);                         // jmp dispatch
+            break;
+    }
+}
+
+JitCode* compileInstructions(Instruction* code, int numberOfInstructions)
+{
+    Assembler a = { 0 };
+
+    if(numberOfInstructions <= 0) return NULL;
+
+    size_t* offsets = malloc(numberOfInstructions * sizeof(size_t));
+
+    // Entry point: int entry(VirtualMachine* vm, JitCode* jit)
+    EMIT(&a, 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57);      // push rbx, rbp, r12 - r15
+    EMIT(&a, 0x48, 0x83, 0xEC, 0x08);                                          // sub rsp, 8
+    EMIT(&a, 0x48, 0x89, 0xFB);                                                // mov rbx, rdi
+    EMIT(&a, 0x49, 0x89, 0xF4);                                                // mov r12, rsi
+    EMIT(&a, 0x4C, 0x8D, 0xAB); emit32(&a, (int32_t)offsetof(VirtualMachine, stack)); // lea r13, [rbx + stack]
+    EMIT(&a, 0x44, 0x8B, 0xB3); emit32(&a, BP_DISP);                           // mov r14d, [rbx + BP]
+    EMIT(&a, 0x44, 0x8B, 0xBB); emit32(&a, SP_DISP);                           // mov r15d, [rbx + SP]
+    EMIT(&a, 0x8B, 0x8B); emit32(&a, PC_DISP);                                 // mov ecx, [rbx + PC]
+
+    // Dispatch: jump to the instruction whose index is in ecx
+    size_t dispatch = a.size;
+    EMIT(&a, 0x81, 0xF9); emit32(&a, numberOfInstructions);                    // cmp ecx, numberOfInstructions
+    EMIT(&a, 0x0F, 0x83); emit32(&a, 0);                                       // jae outside
+    size_t outsideJump = a.size;
+    EMIT(&a, 0x49, 0x8B, 0x14, 0x24);                                          // mov rdx, [r12]
+    EMIT(&a, 0xFF, 0x24, 0xCA);                                                // jmp [rdx + rcx*8]
+
+    // Outside of the code memory: let the interpreter report it
+    int32_t rel = (int32_t)(a.size - outsideJump);
+    memcpy(a.bytes + outsideJump - 4, &rel, 4);
+    EMIT(&a, 0x89, 0x8B); emit32(&a, PC_DISP);                                 // mov [rbx + PC], ecx
+    EMIT(&a, 0xB8); emit32(&a, JIT_INTERPRET);                                 // mov eax, JIT_INTERPRET
+
+    // Exit: write back BP and SP, return eax
+    size_t exit = a.size;
+    EMIT(&a, 0x44, 0x89, 0xB3); emit32(&a, BP_DISP);                           // mov [rbx + BP], r14d
+    EMIT(&a, 0x44, 0x89, 0xBB); emit32(&a, SP_DISP);                           // mov [rbx + SP], r15d
+    EMIT(&a, 0x48, 0x83, 0xC4, 0x08);                                          // add rsp, 8
+    EMIT(&a, 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B, 0xC3); // pop r15 - r12, rbp, rbx; ret
+
+    for(int i = 0; i < numberOfInstructions; i++)
+    {
+        offsets[i] = a.size;
+
+        if(hasTemplate(code[i], numberOfInstructions))
+        {
+            emitInstruction(&a, code[i], i, dispatch, exit);
+        }
+        else
+        {
+            EMIT(&a, 0xC7, 0x83); emit32(&a, PC_DISP); emit32(&a, i);          // mov dword [rbx + PC], i
+            EMIT(&a, 0xB8); emit32(&a, JIT_INTERPRET);                         // mov eax, JIT_INTERPRET
+            EMIT(&a, 0xE9); emitRelativeTo(&a, exit);                          // jmp exit
+        }
+    }
+
+    // Running past the last instruction is left to the interpreter as well
+    EMIT(&a, 0xC7, 0x83); emit32(&a, PC_DISP); emit32(&a, numberOfInstructions);
+    EMIT(&a, 0xB8); emit32(&a, JIT_INTERPRET);
+    EMIT(&a, 0xE9); emitRelativeTo(&a, exit);
+
+    for(int k = 0; k < a.numberOfPatches; k++)
+    {
+        rel = (int32_t)(offsets[a.patchTargets[k]] - (a.patchOffsets[k] + 4));
+        memcpy(a.bytes + a.patchOffsets[k], &rel, 4);
+    }
+
+    JitCode* jit = NULL;
+    unsigned char* buffer = mmap(NULL, a.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(buffer != MAP_FAILED)
+    {
+        memcpy(buffer, a.bytes, a.size);
+
+        if(mprotect(buffer, a.size, PROT_READ | PROT_EXEC))
+        {
+            munmap(buffer, a.size);
+        }
+        else
+        {
+            jit = malloc(sizeof(JitCode));
+            jit->buffer = buffer;
+            jit->bufferSize = a.size;
+            jit->entry = (int (*)(VirtualMachine*, JitCode*))buffer;
+
+            jit->addresses = malloc(numberOfInstructions * sizeof(unsigned char*));
+            for(int i = 0; i < numberOfInstructions; i++)
+                jit->addresses[i] = buffer + offsets[i];
+
+            jit->code = malloc(numberOfInstructions * sizeof(Instruction));
+            memcpy(jit->code, code, numberOfInstructions * sizeof(Instruction));
+            jit->numberOfInstructions = numberOfInstructions;
+        }
+    }
+
+    free(offsets);
+    free(a.bytes);
+    free(a.patchOffsets);
+    free(a.patchTargets);
+
+    return jit;
+}
+
+#else
+
+JitCode* compileInstructions(Instruction* code, int numberOfInstructions)
+{
+    (void)code;
+    (void)numberOfInstructions;
+
+    // No templates for this host
+    return NULL;
+}
+
+#endif
+
+void deleteJitCode(JitCode* jit)
+{
+    if(!jit) return;
+
+    munmap(jit->buffer, jit->bufferSize);
+    free(jit->addresses);
+    free(jit->code);
+    free(jit);
+}
+
+/**
+ * Runs the translated code, interpreting the instructions it leaves for the
+ * interpreter, until the machine halts.
+ * */
+static int runTranslated(VirtualMachine* vm, void* arg)
+{
+    JitCode* jit = arg;
+
+    while( jit->entry(vm, jit) == JIT_INTERPRET )
+    {
+        if( stepVirtualMachine(vm, jit->code, jit->numberOfInstructions, jit->vm_inp, jit->vm_outp) )
+            break;
+    }
+
+    return VM_HALTED;
+}
+
+int runJitCode(JitCode* jit, VirtualMachine* vm, FILE* vm_inp, FILE* vm_outp)
+{
+    jit->vm_inp = vm_inp;
+    jit->vm_outp = vm_outp;
+
+    resetVirtualMachine(vm);
+
+    return runGuarded(vm, runTranslated, jit);
+}
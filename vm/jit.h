@@ -0,0 +1,39 @@
+#ifndef __JIT_H__
+#define __JIT_H__
+
+#include <stdio.h>
+#include "data.h"
+
+/**
+ * PM/0 code translated to x86-64 machine code.
+ * */
+typedef struct JitCode JitCode;
+
+/**
+ * Translates each instruction of the given code to a fixed template of x86-64
+ * machine code in an executable mmap'd buffer. BP and SP of the virtual
+ * machine are kept in host registers while the translated code runs. SIO
+ * instructions call back into the runtime.
+ *
+ * Instructions without a template (e.g. unknown opcodes or jumps outside the
+ * code memory) leave the translated code, are executed by the interpreter
+ * and the translated code is re-entered afterwards.
+ *
+ * Returns NULL if the host is not x86-64 or the buffer could not be mapped.
+ * */
+JitCode* compileInstructions(Instruction* code, int numberOfInstructions);
+
+/**
+ * Unmaps the machine code and deallocates the JitCode.
+ * */
+void deleteJitCode(JitCode*);
+
+/**
+ * Resets the virtual machine and runs the translated code on it until it
+ * halts. The output of SIO instructions is identical to the interpreter's.
+ *
+ * Returns VM_HALTED or VM_STACK_OVERFLOW.
+ * */
+int runJitCode(JitCode* jit, VirtualMachine* vm, FILE* vm_inp, FILE* vm_outp);
+
+#endif
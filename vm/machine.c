@@ -0,0 +1,450 @@
+#include "machine.h"
+#include "vm.h"
+#include "verifier.h"
+#include <ctype.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * Bookkeeping of a mapped virtual machine. It is stored at the beginning of
+ * the mapped region:
+ *
+ * | MachineHeader | padding | VirtualMachine (registers + stack) | guard |
+ *
+ * The padding makes the end of the stack coincide with the guard, which
+ * covers MAX_FRAME_SIZE slots rounded up to whole pages.
+ * */
+typedef struct {
+    size_t regionSize;
+    size_t guardSize;
+    char* guard;
+    int stackHeight;
+} MachineHeader;
+
+/**
+ * The guard of the machine that is currently being run by this thread and
+ * the point to jump back to if it is touched.
+ * */
+static __thread struct {
+    int active;
+    char* guard;
+    size_t guardSize;
+    sigjmp_buf env;
+} currentRun;
+
+static size_t roundUp(size_t size, size_t pageSize)
+{
+    return (size + pageSize - 1) / pageSize * pageSize;
+}
+
+static MachineHeader* getHeader(VirtualMachine* vm)
+{
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+    // See createVirtualMachine() for why rounding down finds the header.
+    char* p = (char*)vm - sizeof(MachineHeader);
+
+    return (MachineHeader*)((size_t)p / pageSize * pageSize);
+}
+
+VirtualMachine* createVirtualMachine(int stackHeight)
+{
+    if(stackHeight <= 0) return NULL;
+
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+    // Bytes from the beginning of the machine to the end of its stack
+    size_t machineSize = offsetof(VirtualMachine, stack) + (size_t)stackHeight * sizeof(int);
+
+    /**
+     * Header and machine are followed by the guard. A verified program
+     * addresses no slot farther than MAX_FRAME_SIZE from the base of its
+     * activation record, which is below the guard, so it touches the guard
+     * before any slot past it.
+     * */
+    size_t usableSize = roundUp(sizeof(MachineHeader) + machineSize, pageSize);
+    size_t guardSize = roundUp((size_t)MAX_FRAME_SIZE * sizeof(int), pageSize);
+    size_t regionSize = usableSize + guardSize;
+
+    char* region = mmap(NULL, regionSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(region == MAP_FAILED) return NULL;
+
+    char* guard = region + usableSize;
+    if(mprotect(guard, guardSize, PROT_NONE))
+    {
+        munmap(region, regionSize);
+        return NULL;
+    }
+
+    MachineHeader* header = (MachineHeader*)region;
+    header->regionSize = regionSize;
+    header->guardSize = guardSize;
+    header->guard = guard;
+    header->stackHeight = stackHeight;
+
+    /**
+     * The machine ends right at the guard. Since the distance between the
+     * header and the machine is less than a page, getHeader() could find the
+     * header by rounding the address of the machine down to a page boundary.
+     * */
+    return (VirtualMachine*)(guard - machineSize);
+}
+
+void deleteVirtualMachine(VirtualMachine* vm)
+{
+    if(!vm) return;
+
+    MachineHeader* header = getHeader(vm);
+
+    munmap(header, header->regionSize);
+}
+
+int getStackHeight(VirtualMachine* vm)
+{
+    if(!vm) return 0;
+
+    return getHeader(vm)->stackHeight;
+}
+
+int readInstructionList(FILE* inp, Instruction* code, int maxLength)
+{
+    int numberOfInstructions = 0;
+    Instruction ins;
+
+    if(!inp) return 0;
+
+    while( fscanf(inp, "%d %d %d %d", &ins.op, &ins.r, &ins.l, &ins.m) == 4 )
+    {
+        if(numberOfInstructions == maxLength) return -1;
+
+        code[numberOfInstructions++] = ins;
+    }
+
+    return numberOfInstructions;
+}
+
+/**
+ * Action of SIGSEGV before onSegmentationFault() was installed, and the
+ * once control of its installation.
+ * */
+static struct sigaction previousAction;
+static pthread_once_t handlerOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Jumps back to runGuarded() if the fault is on the guard of the machine
+ * being run by this thread. Otherwise, forwards the fault to the previous
+ * action. The default action, or an ignored signal, is restored so that the
+ * faulting instruction crashes the process once it is re-executed.
+ * */
+static void onSegmentationFault(int sig, siginfo_t* info, void* context)
+{
+    char* address = (char*)info->si_addr;
+
+    if(currentRun.active && address >= currentRun.guard && address < currentRun.guard + currentRun.guardSize)
+    {
+        currentRun.active = 0;
+        siglongjmp(currentRun.env, 1);
+    }
+
+    if(previousAction.sa_flags & SA_SIGINFO)
+        previousAction.sa_sigaction(sig, info, context);
+    else if(previousAction.sa_handler == SIG_DFL || previousAction.sa_handler == SIG_IGN)
+        sigaction(sig, &previousAction, NULL);
+    else
+        previousAction.sa_handler(sig);
+}
+
+/**
+ * Installs onSegmentationFault() for the whole process. It is never removed,
+ * since another thread could be running a machine at any time.
+ * */
+static void installSegmentationFaultHandler(void)
+{
+    struct sigaction action;
+
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = onSegmentationFault;
+    action.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, &previousAction);
+}
+
+/**
+ * Names of the opcodes, indexed by opcode. "illegal" at index 0.
+ * */
+static const char* opcodeNames[] = {
+    "illegal",
+    [LIT] = "LIT", [RTN] = "RTN", [LOD] = "LOD", [STO] = "STO", [CAL] = "CAL",
+    [INC] = "INC", [JMP] = "JMP", [JPC] = "JPC",
+
+    [SIO_WRITE] = "SIO_WRITE", [SIO_READ] = "SIO_READ", [SIO_HALT] = "SIO_HALT",
+
+    [NEG] = "NEG", [ADD] = "ADD", [SUB] = "SUB", [MUL] = "MUL", [DIV] = "DIV",
+    [ODD] = "ODD", [MOD] = "MOD", [EQL] = "EQL", [NEQ] = "NEQ", [LSS] = "LSS",
+    [LEQ] = "LEQ", [GTR] = "GTR", [GEQ] = "GEQ",
+
+    [JEQ] = "JEQ", [JNE] = "JNE", [JLT] = "JLT", [JLE] = "JLE", [JGT] = "JGT",
+    [JGE] = "JGE",
+
+    [ADDI] = "ADDI", [SUBI] = "SUBI", [MULI] = "MULI", [DIVI] = "DIVI",
+
+    [JEQI] = "JEQI", [JNEI] = "JNEI", [JLTI] = "JLTI", [JLEI] = "JLEI",
+    [JGTI] = "JGTI", [JGEI] = "JGEI",
+
+    [MOV3] = "MOV3", [ADD3] = "ADD3", [SUB3] = "SUB3", [MUL3] = "MUL3", [DIV3] = "DIV3",
+
+    [JEQ3] = "JEQ3", [JNE3] = "JNE3", [JLT3] = "JLT3", [JLE3] = "JLE3",
+    [JGT3] = "JGT3", [JGE3] = "JGE3",
+
+    [LCAL] = "LCAL", [LRTN] = "LRTN"
+};
+
+const char* getOpcodeName(int op)
+{
+    return op > 0 && op < OPCODE_COUNT && opcodeNames[op] ? opcodeNames[op] : opcodeNames[0];
+}
+
+/**
+ * Returns the lower case name of the given opcode, as opcodes[] of vm.o,
+ * which names the three SIO opcodes "sio". The names of the other opcodes
+ * are written to name in lower case.
+ * */
+static const char* getTraceName(int op, char name[MAX_OPCODE_NAME_LENGTH + 1])
+{
+    if(op >= LIT && op <= GEQ) return opcodes[op];
+
+    const char* upper = getOpcodeName(op);
+    int i = 0;
+
+    for(; upper[i] && i < MAX_OPCODE_NAME_LENGTH; i++) name[i] = tolower((unsigned char)upper[i]);
+    name[i] = '\0';
+
+    return name;
+}
+
+/**
+ * Returns the value of the given operand of a three-address instruction.
+ * */
+static int readOperand(VirtualMachine* vm, int operand)
+{
+    switch(OPERAND_KIND(operand))
+    {
+        case OPERAND_REGISTER: return vm->RF[OPERAND_VALUE(operand)];
+        case OPERAND_VARIABLE: return vm->stack[vm->BP + OPERAND_VALUE(operand)];
+        default:               return OPERAND_VALUE(operand);
+    }
+}
+
+/**
+ * Stores the given value to the register or the variable of the given
+ * operand of a three-address instruction.
+ * */
+static void writeOperand(VirtualMachine* vm, int operand, int value)
+{
+    if(OPERAND_KIND(operand) == OPERAND_REGISTER) vm->RF[OPERAND_VALUE(operand)] = value;
+    else vm->stack[vm->BP + OPERAND_VALUE(operand)] = value;
+}
+
+/**
+ * Executes a single instruction as executeInstruction() of vm.o does,
+ * including the compare and branch, the immediate operand, the
+ * three-address and the leaf call instructions that vm.o does not know.
+ * */
+static int execute(VirtualMachine* vm, Instruction ins, FILE* vm_inp, FILE* vm_outp)
+{
+    int taken;
+
+    // The instructions of vm.o come first, with a single compare
+    if(ins.op < JEQ) return executeInstruction(vm, ins, vm_inp, vm_outp);
+
+    switch(ins.op)
+    {
+        case JEQ: taken = vm->RF[ins.r] == vm->RF[ins.l]; break;
+        case JNE: taken = vm->RF[ins.r] != vm->RF[ins.l]; break;
+        case JLT: taken = vm->RF[ins.r] <  vm->RF[ins.l]; break;
+        case JLE: taken = vm->RF[ins.r] <= vm->RF[ins.l]; break;
+        case JGT: taken = vm->RF[ins.r] >  vm->RF[ins.l]; break;
+        case JGE: taken = vm->RF[ins.r] >= vm->RF[ins.l]; break;
+
+        case JEQI: taken = vm->RF[ins.r] == ins.l; break;
+        case JNEI: taken = vm->RF[ins.r] != ins.l; break;
+        case JLTI: taken = vm->RF[ins.r] <  ins.l; break;
+        case JLEI: taken = vm->RF[ins.r] <= ins.l; break;
+        case JGTI: taken = vm->RF[ins.r] >  ins.l; break;
+        case JGEI: taken = vm->RF[ins.r] >= ins.l; break;
+
+        case ADDI: vm->RF[ins.r] = vm->RF[ins.l] + ins.m; return 0;
+        case SUBI: vm->RF[ins.r] = vm->RF[ins.l] - ins.m; return 0;
+        case MULI: vm->RF[ins.r] = vm->RF[ins.l] * ins.m; return 0;
+        case DIVI: vm->RF[ins.r] = vm->RF[ins.l] / ins.m; return 0;
+
+        case MOV3: writeOperand(vm, ins.r, readOperand(vm, ins.l)); return 0;
+        case ADD3: writeOperand(vm, ins.r, readOperand(vm, ins.l) + readOperand(vm, ins.m)); return 0;
+        case SUB3: writeOperand(vm, ins.r, readOperand(vm, ins.l) - readOperand(vm, ins.m)); return 0;
+        case MUL3: writeOperand(vm, ins.r, readOperand(vm, ins.l) * readOperand(vm, ins.m)); return 0;
+        case DIV3: writeOperand(vm, ins.r, readOperand(vm, ins.l) / readOperand(vm, ins.m)); return 0;
+
+        case JEQ3: taken = readOperand(vm, ins.r) == readOperand(vm, ins.l); break;
+        case JNE3: taken = readOperand(vm, ins.r) != readOperand(vm, ins.l); break;
+        case JLT3: taken = readOperand(vm, ins.r) <  readOperand(vm, ins.l); break;
+        case JLE3: taken = readOperand(vm, ins.r) <= readOperand(vm, ins.l); break;
+        case JGT3: taken = readOperand(vm, ins.r) >  readOperand(vm, ins.l); break;
+        case JGE3: taken = readOperand(vm, ins.r) >= readOperand(vm, ins.l); break;
+
+        // The PC is already at the instruction after the LCAL
+        case LCAL: vm->RF[ins.r] = vm->PC; vm->PC = ins.m; return 0;
+        case LRTN: vm->PC = vm->RF[ins.r]; return 0;
+
+        default:
+            return executeInstruction(vm, ins, vm_inp, vm_outp);
+    }
+
+    if(taken) vm->PC = ins.m;
+
+    return 0;
+}
+
+/**
+ * Writes the code memory in the same format as simulateVM() does.
+ * */
+static void dumpCodeMemory(FILE* outp, Instruction* code, int numberOfInstructions)
+{
+    char name[MAX_OPCODE_NAME_LENGTH + 1];
+
+    fprintf(outp, "***Code Memory***\n%3s %3s %3s %3s %3s \n", "#", "OP", "R", "L", "M");
+
+    for(int i = 0; i < numberOfInstructions; i++)
+    {
+        fprintf(outp, "%3d %3s %3d %3d %3d \n", i, getTraceName(code[i].op, name), code[i].r, code[i].l, code[i].m);
+    }
+}
+
+void resetVirtualMachine(VirtualMachine* vm)
+{
+    // The stack is only cleared by the kernel on mapping
+    vm->BP = 1;
+    vm->SP = 0;
+    vm->PC = 0;
+    vm->IR = 0;
+    memset(vm->RF, 0, sizeof(vm->RF));
+}
+
+int stepVirtualMachine(VirtualMachine* vm, Instruction* code, int numberOfInstructions, FILE* vm_inp, FILE* vm_outp)
+{
+    int line = vm->PC;
+
+    // Running off the code memory is reported as an illegal instruction
+    Instruction ins = { 0, 0, 0, 0 };
+    if(line >= 0 && line < numberOfInstructions) ins = code[line];
+
+    vm->PC++;
+
+    return execute(vm, ins, vm_inp, vm_outp) || !(vm->PC || vm->BP || vm->SP);
+}
+
+int runGuarded(VirtualMachine* vm, int (*run)(VirtualMachine*, void*), void* arg)
+{
+    MachineHeader* header = getHeader(vm);
+
+    pthread_once(&handlerOnce, installSegmentationFaultHandler);
+
+    currentRun.guard = header->guard;
+    currentRun.guardSize = header->guardSize;
+
+    if(sigsetjmp(currentRun.env, 1))
+    {
+        // A push went past the last stack slot
+        return VM_STACK_OVERFLOW;
+    }
+
+    currentRun.active = 1;
+
+    int result = run(vm, arg);
+
+    currentRun.active = 0;
+
+    return result;
+}
+
+/**
+ * Arguments of interpret(), which is run by runVirtualMachine()
+ * */
+typedef struct {
+    Instruction* code;
+    int numberOfInstructions;
+    FILE* outp;
+    FILE* vm_inp;
+    FILE* vm_outp;
+    int verified;
+    Profile* profile;
+} InterpreterArgs;
+
+static int interpret(VirtualMachine* vm, void* arg)
+{
+    InterpreterArgs* args = arg;
+    Instruction* code = args->code;
+    char name[MAX_OPCODE_NAME_LENGTH + 1];
+    int halted = 0, returned = 0;
+
+    while(!halted && (vm->PC || vm->BP || vm->SP))
+    {
+        int line = vm->PC;
+
+        // Running off the code memory is reported as an illegal instruction.
+        // Verified code only runs off by RTN, since the return address is
+        // read from the stack, which the program could have overwritten.
+        Instruction ins = { 0, 0, 0, 0 };
+        if((args->verified && !returned) || (line >= 0 && line < args->numberOfInstructions)) ins = code[line];
+        returned = ins.op == RTN;
+
+        if(args->profile) profileInstruction(args->profile, line, ins);
+
+        vm->PC++;
+        halted = execute(vm, ins, args->vm_inp, args->vm_outp);
+
+        if(args->outp)
+        {
+            fprintf(args->outp, "%3d %3s %3d %3d %3d %3d %3d %3d ",
+                line, getTraceName(ins.op, name), ins.r, ins.l, ins.m, vm->PC, vm->BP, vm->SP);
+            dumpStack(args->outp, vm->stack, vm->SP, vm->BP);
+            fputc('\n', args->outp);
+        }
+    }
+
+    return VM_HALTED;
+}
+
+int runVirtualMachine(
+    VirtualMachine* vm,
+    Instruction* code,
+    int numberOfInstructions,
+    FILE* outp,
+    FILE* vm_inp,
+    FILE* vm_outp,
+    int verified,
+    Profile* profile
+)
+{
+    InterpreterArgs args = { code, numberOfInstructions, outp, vm_inp, vm_outp, verified, profile };
+
+    resetVirtualMachine(vm);
+
+    if(outp)
+    {
+        dumpCodeMemory(outp, code, numberOfInstructions);
+        fprintf(outp, "\n***Execution***\n");
+        fprintf(outp, "%3s %3s %3s %3s %3s %3s %3s %3s %3s \n", "#", "OP", "R", "L", "M", "PC", "BP", "SP", "STK");
+    }
+
+    int result = runGuarded(vm, interpret, &args);
+
+    if(outp && result == VM_HALTED) fprintf(outp, "HLT\n");
+
+    return result;
+}
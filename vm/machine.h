@@ -0,0 +1,115 @@
+#ifndef __MACHINE_H__
+#define __MACHINE_H__
+
+#include <stdio.h>
+#include "data.h"
+#include "profiler.h"
+
+/**
+ * Return codes of runVirtualMachine()
+ * */
+enum {
+    VM_HALTED = 0,
+    VM_STACK_OVERFLOW = 1
+};
+
+/**
+ * Number of opcodes, counting the illegal opcode 0, and the length of the
+ * longest name of an opcode.
+ * */
+#define OPCODE_COUNT (LRTN + 1)
+#define MAX_OPCODE_NAME_LENGTH 9
+
+/**
+ * Returns the upper case name of the given opcode, such as "SIO_WRITE" or
+ * "JEQ3", or "illegal" for an invalid opcode. The execution history writes
+ * the same names in lower case, except for the SIO opcodes, which vm.o names
+ * "sio".
+ * */
+const char* getOpcodeName(int op);
+
+/**
+ * Creates a virtual machine whose stack can hold stackHeight slots.
+ *
+ * The machine is placed in an mmap'd region so that the last stack slot is
+ * immediately followed by an inaccessible guard of MAX_FRAME_SIZE slots, see
+ * verifier.h. A push past the end of the stack faults on the guard and is
+ * reported by runVirtualMachine() as VM_STACK_OVERFLOW, therefore verified
+ * instructions are executed without any explicit bounds checks on the stack.
+ *
+ * stackHeight may be smaller or (much) larger than MAX_STACK_HEIGHT. Pages of
+ * the stack are only backed by memory once they are touched.
+ *
+ * Returns NULL if the region could not be mapped.
+ * */
+VirtualMachine* createVirtualMachine(int stackHeight);
+
+/**
+ * Unmaps the region allocated by createVirtualMachine()
+ * */
+void deleteVirtualMachine(VirtualMachine*);
+
+/**
+ * Returns the number of stack slots of the given virtual machine.
+ * */
+int getStackHeight(VirtualMachine*);
+
+/**
+ * Reads at most maxLength instructions from the given file to code.
+ * Returns the number of instructions read, or -1 if the file contains more
+ * than maxLength instructions.
+ * */
+int readInstructionList(FILE* inp, Instruction* code, int maxLength);
+
+/**
+ * Sets the registers to their initial values: BP = 1, SP = PC = IR = 0 and
+ * every register of the register file to 0.
+ * */
+void resetVirtualMachine(VirtualMachine*);
+
+/**
+ * Executes the single instruction pointed by the program counter. Fetching
+ * an instruction outside the code memory is reported as an illegal
+ * instruction.
+ * Returns 1 if the machine halted, either by SIO_HALT or by returning from
+ * the outermost activation record. Returns 0 otherwise.
+ * */
+int stepVirtualMachine(VirtualMachine* vm, Instruction* code, int numberOfInstructions, FILE* vm_inp, FILE* vm_outp);
+
+/**
+ * Calls run(vm, arg) while the guard of vm is being watched. The SIGSEGV
+ * handler that watches it is installed on the first call and left installed,
+ * faults outside the guard are forwarded to the previous action.
+ * Returns VM_STACK_OVERFLOW if run pushes past the last stack slot of vm.
+ * Otherwise, returns the value returned by run.
+ * */
+int runGuarded(VirtualMachine* vm, int (*run)(VirtualMachine*, void*), void* arg);
+
+/**
+ * Resets and executes the given code on the virtual machine until it halts.
+ *
+ * outp: If not NULL, the code memory and the execution history are written
+ *       to it in the same format as simulateVM() does.
+ *
+ * vm_inp, vm_outp: Streams attached to SIO instructions.
+ *
+ * verified: Non-zero if the code has passed verifyInstructions(). Then, the
+ *           program counter is only checked against the code memory after
+ *           an RTN, instead of before each instruction is fetched.
+ *
+ * profile: If not NULL, every executed instruction is recorded to it.
+ *
+ * Returns VM_HALTED or VM_STACK_OVERFLOW.
+ * */
+int runVirtualMachine(
+    VirtualMachine* vm,
+    Instruction* code,
+    int numberOfInstructions,
+    FILE* outp,
+    FILE* vm_inp,
+    FILE* vm_outp,
+    int verified,
+    Profile* profile
+);
+
+#endif
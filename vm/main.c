@@ -1,64 +1,216 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "vm.h"
+#include "machine.h"
+#include "verifier.h"
+#include "jit.h"
+#include "profiler.h"
+
+void printUsage()
+{
+    fprintf(stderr, "Usage: vm.out [-s stack_height] [-n] [-j] [-p report_file] [-f folded_file] [-y symbol_file] (ins_inp_file) (simul_outp_file) [vm_inp_file=stdin] [vm_outp_file=stdout]\n");
+
+    fprintf(stderr, "\n\tstack_height  The number of slots of the stack of the virtual machine."
+                    "\n\t              Defaults to %d. Pushing past the last slot terminates the"
+                    "\n\t              virtual machine with a stack overflow error.\n", MAX_STACK_HEIGHT);
+
+    fprintf(stderr, "\n\t-n            Do not verify the instructions before running them. Only the"
+                    "\n\t              program counter is checked to be inside the code memory on"
+                    "\n\t              every instruction, the stack accesses are not checked.\n");
+
+    fprintf(stderr, "\n\t-j            Translate the instructions to native code before running them."
+                    "\n\t              Ignored with -n, if the execution history is written to a file"
+                    "\n\t              other than /dev/null, or if the host is not x86-64.\n");
+
+    fprintf(stderr, "\n\treport_file   Profile the execution and write the instruction counts of each"
+                    "\n\t              procedure, each opcode and the most executed instructions to"
+                    "\n\t              this file.\n");
+
+    fprintf(stderr, "\n\tfolded_file   Profile the execution and write the instruction counts of each"
+                    "\n\t              call stack to this file in the folded format of flame graphs.\n");
+
+    fprintf(stderr, "\n\tsymbol_file   The symbol side-file written by the code generator, used to"
+                    "\n\t              name the procedures in the profile.\n");
+
+    fprintf(stderr, "\n\tins_inp_file  The path to the file containing the list of instructions to"
+                    "\n\t              be loaded to code memory of the virtual machine.\n");
+
+    fprintf(stderr, "\n\tsimul_outp_file  The path to the file to write the simulation output, which"
+                    "\n\t                 contains both code memory and execution history.\n");
+    fprintf(stderr, "\n\tvm_inp_file  The path to the file that is going to be attached as the input"
+                    "\n\t             stream to the virtual machine. Useful to feed input for SIO"
+                    "\n\t             instructions. Use dash ('-') to assign to stdin.\n");
+    fprintf(stderr, "\n\tvm_outp_file The path to the file that is going to be attached as the output"
+                    "\n\t             stream to the virtual machine. Useful to save the output printed"
+                    "\n\t             by SIO instructions. Use dash ('-') to assign to stdout.\n");
+}
 
 int main(int argc, char **argv)
 {
     FILE *inp, *outp, *vm_inp, *vm_outp;
+    int stackHeight = MAX_STACK_HEIGHT;
+    int verify = 1;
+    int jit = 0;
+    const char *reportPath = NULL, *foldedPath = NULL, *symbolPath = NULL;
+    int argi = 1;
 
-    if(argc == 3)
+    // Options precede the file arguments
+    while(argi < argc && argv[argi][0] == '-' && argv[argi][1] != '\0')
     {
-        inp     = fopen(argv[1], "r");
-        outp    = fopen(argv[2], "w");
-
-        vm_inp  = stdin;
-        vm_outp = stdout;
+        if( !strcmp(argv[argi], "-s") && argi + 1 < argc )
+        {
+            stackHeight = atoi(argv[argi + 1]);
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-n") )
+        {
+            verify = 0;
+            argi++;
+        }
+        else if( !strcmp(argv[argi], "-j") )
+        {
+            jit = 1;
+            argi++;
+        }
+        else if( !strcmp(argv[argi], "-p") && argi + 1 < argc )
+        {
+            reportPath = argv[argi + 1];
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-f") && argi + 1 < argc )
+        {
+            foldedPath = argv[argi + 1];
+            argi += 2;
+        }
+        else if( !strcmp(argv[argi], "-y") && argi + 1 < argc )
+        {
+            symbolPath = argv[argi + 1];
+            argi += 2;
+        }
+        else
+        {
+            printUsage();
+            return -1;
+        }
+    }
 
-        simulateVM(inp, outp, vm_inp, vm_outp);
+    argc -= argi - 1;
+    argv += argi - 1;
 
-        fclose(inp);
-        fclose(outp);
+    if(argc != 3 && argc != 5)
+    {
+        printUsage();
+        return -1;
     }
-    else if(argc == 5)
+
+    inp     = fopen(argv[1], "r");
+    outp    = fopen(argv[2], "w");
+
+    if(!inp || !outp)
     {
-        inp     = fopen(argv[1], "r");
-        outp    = fopen(argv[2], "w");
+        fprintf(stderr, "Could not open \"%s\"\n", inp ? argv[2] : argv[1]);
+        return -1;
+    }
 
+    if(argc == 3)
+    {
+        vm_inp  = stdin;
+        vm_outp = stdout;
+    }
+    else
+    {
         // vm_inp
         if( strcmp(argv[3], "-") ) vm_inp = fopen(argv[3], "r");
         else                       vm_inp = stdin;
 
         // vm_outp
-        if( strcmp(argv[3], "-") ) vm_outp = fopen(argv[4], "w");
+        if( strcmp(argv[4], "-") ) vm_outp = fopen(argv[4], "w");
         else                       vm_outp = stdout;
+    }
+
+    // Load the code memory
+    Instruction code[MAX_CODE_LENGTH];
+    int numberOfInstructions = readInstructionList(inp, code, MAX_CODE_LENGTH);
 
-        simulateVM(inp, outp, vm_inp, vm_outp);
+    VirtualMachine* vm = createVirtualMachine(stackHeight);
 
-        fclose(inp);
-        fclose(outp);
+    // Formatting the execution history is skipped if it is going to be discarded
+    FILE* trace = strcmp(argv[2], "/dev/null") ? outp : NULL;
 
+    Profile* profile = NULL;
+    if( (reportPath || foldedPath) && numberOfInstructions >= 0 )
+    {
+        profile = createProfile(numberOfInstructions);
+
+        FILE* symbols = symbolPath ? fopen(symbolPath, "r") : NULL;
+        if(symbolPath && !symbols) fprintf(stderr, "Could not open \"%s\"\n", symbolPath);
+
+        readProcedureNames(profile, symbols);
+        if(symbols) fclose(symbols);
+    }
+
+    // The translated code does not write an execution history or a profile,
+    // and it relies on the verification for the targets of jumps and calls
+    JitCode* jitCode = NULL;
+    if(jit && verify && !trace && !profile && numberOfInstructions > 0) jitCode = compileInstructions(code, numberOfInstructions);
+
+    int result = VM_HALTED;
+    int err = 0;
+    if(numberOfInstructions < 0)
+    {
+        fprintf(stderr, "VM cannot load more than %d instructions\nTerminating VM..\n", MAX_CODE_LENGTH);
+        err = -1;
+    }
+    else if( verify && verifyInstructions(code, numberOfInstructions, stderr) )
+    {
+        fprintf(stderr, "VM cannot run code that failed verification\nTerminating VM..\n");
+        err = -1;
+    }
+    else if(!vm)
+    {
+        fprintf(stderr, "VM cannot allocate a stack of %d slots\nTerminating VM..\n", stackHeight);
+        err = -1;
+    }
+    else
+    {
+        if(jitCode) result = runJitCode(jitCode, vm, vm_inp, vm_outp);
+        else        result = runVirtualMachine(vm, code, numberOfInstructions, trace, vm_inp, vm_outp, verify, profile);
+    }
+
+    if(result == VM_STACK_OVERFLOW)
+    {
+        fprintf(stderr, "VM stack overflow: more than %d stack slots are needed\nTerminating VM..\n", stackHeight);
+        err = -1;
+    }
+
+    if(profile && result == VM_HALTED && !err)
+    {
+        FILE* report = reportPath ? fopen(reportPath, "w") : NULL;
+        FILE* folded = foldedPath ? fopen(foldedPath, "w") : NULL;
+
+        if(report) printProfileReport(profile, code, report);
+        if(folded) printFoldedStacks(profile, folded);
+
+        if(report) fclose(report);
+        if(folded) fclose(folded);
+    }
+
+    deleteProfile(profile);
+    deleteJitCode(jitCode);
+    deleteVirtualMachine(vm);
+
+    fclose(inp);
+    fclose(outp);
+
+    if(argc == 5)
+    {
         // vm_inp : close the file stream if it is not stdin
         if( strcmp(argv[3], "-") ) fclose(vm_inp);
 
         // vm_outp: close the file stream if it is not stdout
         if( strcmp(argv[4], "-") ) fclose(vm_outp);
     }
-    else
-    {
-        fprintf(stderr, "Usage: vm.out (ins_inp_file) (simul_outp_file) [vm_inp_file=stdin] [vm_outp_file=stdout]\n");
-
-        fprintf(stderr, "\n\tins_inp_file  The path to the file containing the list of instructions to"
-                        "\n\t              be loaded to code memory of the virtual machine.\n");
-
-        fprintf(stderr, "\n\tsimul_outp_file  The path to the file to write the simulation output, which"
-                        "\n\t                 contains both code memory and execution history.\n");
-        fprintf(stderr, "\n\tvm_inp_file  The path to the file that is going to be attached as the input"
-                        "\n\t             stream to the virtual machine. Useful to feed input for SIO"
-                        "\n\t             instructions. Use dash ('-') to assign to stdin.\n");
-        fprintf(stderr, "\n\tvm_outp_file The path to the file that is going to be attached as the output"
-                        "\n\t             stream to the virtual machine. Useful to save the output printed"
-                        "\n\t             by SIO instructions. Use dash ('-') to assign to stdout.\n");
-    }
 
-    return 0;
+    return err;
 }
@@ -0,0 +1,340 @@
+#include "profiler.h"
+#include "machine.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Calls deeper than this are counted for the procedure at this depth, which
+ * keeps the call tree and the folded stacks of deep recursions bounded.
+ * */
+#define MAX_PROFILE_DEPTH 256
+
+#define MAX_PROCEDURE_NAME_LENGTH 31
+
+#define HOT_INSTRUCTION_COUNT 20
+
+/**
+ * A node of the call tree: a procedure reached through a particular chain of
+ * calls. Nodes refer to each other by their indices.
+ * */
+typedef struct {
+    int entry;
+    int parent;
+    int firstChild;
+    int nextSibling;
+    long long count;
+} CallNode;
+
+struct Profile {
+    int numberOfInstructions;
+
+    // Executions of each instruction and each opcode
+    long long* instructionCounts;
+    long long opcodeCounts[OPCODE_COUNT];
+    long long total;
+
+    // Procedure each instruction was last executed in
+    int* owners;
+
+    // Names of the procedures indexed by their addresses, NULL if unknown
+    char** names;
+
+    // Call tree, whose root is the outermost procedure at address 0
+    CallNode* nodes;
+    int numberOfNodes;
+    int nodeCapacity;
+
+    // Shadow call stack
+    int stack[MAX_PROFILE_DEPTH];
+    int depth;
+    int overflowDepth;
+};
+
+Profile* createProfile(int numberOfInstructions)
+{
+    Profile* profile = calloc(1, sizeof(Profile));
+
+    // Keep every array non-empty
+    int n = numberOfInstructions > 0 ? numberOfInstructions : 1;
+
+    profile->numberOfInstructions = numberOfInstructions;
+    profile->instructionCounts = calloc(n, sizeof(long long));
+    profile->owners = calloc(n, sizeof(int));
+    profile->names = calloc(n, sizeof(char*));
+
+    profile->nodeCapacity = 16;
+    profile->nodes = malloc(profile->nodeCapacity * sizeof(CallNode));
+    profile->nodes[0] = (CallNode){ .entry = 0, .parent = -1, .firstChild = -1, .nextSibling = -1, .count = 0 };
+    profile->numberOfNodes = 1;
+
+    profile->stack[0] = 0;
+    profile->depth = 0;
+
+    return profile;
+}
+
+void deleteProfile(Profile* profile)
+{
+    if(!profile) return;
+
+    for(int i = 0; i < profile->numberOfInstructions; i++)
+        free(profile->names[i]);
+
+    free(profile->names);
+    free(profile->owners);
+    free(profile->instructionCounts);
+    free(profile->nodes);
+    free(profile);
+}
+
+void readProcedureNames(Profile* profile, FILE* symbols)
+{
+    char line[256], name[MAX_PROCEDURE_NAME_LENGTH + 1];
+    int address;
+
+    if(!profile || !symbols) return;
+
+    while( fgets(line, sizeof(line), symbols) )
+    {
+        if( sscanf(line, "proc %d %31s", &address, name) != 2 ) continue;
+        if( address < 0 || address >= profile->numberOfInstructions ) continue;
+
+        free(profile->names[address]);
+        profile->names[address] = strdup(name);
+    }
+}
+
+/**
+ * Returns the node of the procedure at entry called from the given node,
+ * creating it if this is the first such call.
+ * */
+static int getChild(Profile* profile, int parent, int entry)
+{
+    for(int child = profile->nodes[parent].firstChild; child >= 0; child = profile->nodes[child].nextSibling)
+        if(profile->nodes[child].entry == entry) return child;
+
+    if(profile->numberOfNodes == profile->nodeCapacity)
+    {
+        profile->nodeCapacity *= 2;
+        profile->nodes = realloc(profile->nodes, profile->nodeCapacity * sizeof(CallNode));
+    }
+
+    int child = profile->numberOfNodes++;
+    profile->nodes[child] = (CallNode){
+        .entry = entry,
+        .parent = parent,
+        .firstChild = -1,
+        .nextSibling = profile->nodes[parent].firstChild,
+        .count = 0
+    };
+    profile->nodes[parent].firstChild = child;
+
+    return child;
+}
+
+void profileInstruction(Profile* profile, int line, Instruction ins)
+{
+    int node = profile->stack[profile->depth];
+
+    profile->total++;
+    profile->nodes[node].count++;
+
+    if(line >= 0 && line < profile->numberOfInstructions)
+    {
+        profile->instructionCounts[line]++;
+        profile->owners[line] = profile->nodes[node].entry;
+    }
+
+    profile->opcodeCounts[ins.op >= 0 && ins.op < OPCODE_COUNT ? ins.op : 0]++;
+
+    if( (ins.op == CAL || ins.op == LCAL) && ins.m >= 0 && ins.m < profile->numberOfInstructions)
+    {
+        if(profile->depth + 1 < MAX_PROFILE_DEPTH)
+            profile->stack[++profile->depth] = getChild(profile, node, ins.m);
+        else
+            profile->overflowDepth++;
+    }
+    else if(ins.op == RTN || ins.op == LRTN)
+    {
+        if(profile->overflowDepth > 0) profile->overflowDepth--;
+        else if(profile->depth > 0)    profile->depth--;
+    }
+}
+
+/**
+ * Writes the name of the procedure at the given address to buffer.
+ * */
+static const char* getProcedureName(Profile* profile, int entry, char* buffer, size_t size)
+{
+    if(entry >= 0 && entry < profile->numberOfInstructions && profile->names[entry])
+        return profile->names[entry];
+
+    if(entry == 0) snprintf(buffer, size, "program");
+    else           snprintf(buffer, size, "proc@%d", entry);
+
+    return buffer;
+}
+
+/**
+ * Instruction counts of a single procedure, summed over the call tree.
+ * Inclusive counts include the callees, and count recursive calls once.
+ * */
+typedef struct {
+    int entry;
+    long long calls;
+    long long self;
+    long long inclusive;
+} ProcedureCounts;
+
+/**
+ * Returns the number of instructions executed in the subtree of the given
+ * node, and adds the counts of the procedures in the subtree to procedures.
+ * onPath counts the activations of each procedure from the root to the node.
+ * */
+static long long sumCallTree(Profile* profile, int node, ProcedureCounts* procedures, int* onPath)
+{
+    CallNode* n = &profile->nodes[node];
+    long long subtree = n->count;
+
+    onPath[n->entry]++;
+
+    for(int child = n->firstChild; child >= 0; child = profile->nodes[child].nextSibling)
+        subtree += sumCallTree(profile, child, procedures, onPath);
+
+    onPath[n->entry]--;
+
+    procedures[n->entry].entry = n->entry;
+    procedures[n->entry].self += n->count;
+    if(!onPath[n->entry]) procedures[n->entry].inclusive += subtree;
+
+    return subtree;
+}
+
+static int compareProcedures(const void* a, const void* b)
+{
+    const ProcedureCounts* x = a;
+    const ProcedureCounts* y = b;
+
+    if(x->inclusive != y->inclusive) return x->inclusive < y->inclusive ? 1 : -1;
+    return x->entry - y->entry;
+}
+
+static long long* sortedCounts;
+
+static int compareByCount(const void* a, const void* b)
+{
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+
+    if(sortedCounts[x] != sortedCounts[y]) return sortedCounts[x] < sortedCounts[y] ? 1 : -1;
+    return x - y;
+}
+
+static double percentage(long long count, long long total)
+{
+    return total ? 100.0 * count / total : 0.0;
+}
+
+void printProfileReport(Profile* profile, Instruction* code, FILE* outp)
+{
+    char name[MAX_PROCEDURE_NAME_LENGTH + 16];
+    int n = profile->numberOfInstructions > 0 ? profile->numberOfInstructions : 1;
+
+    fprintf(outp, "***Profile***\n");
+    fprintf(outp, "Instructions executed: %lld\n", profile->total);
+
+    // Procedures
+    ProcedureCounts* procedures = calloc(n, sizeof(ProcedureCounts));
+    int* onPath = calloc(n, sizeof(int));
+
+    sumCallTree(profile, 0, procedures, onPath);
+
+    // Calls of a procedure are the executions of the CALs and LCALs targeting it
+    for(int i = 0; i < profile->numberOfInstructions; i++)
+        if( (code[i].op == CAL || code[i].op == LCAL) && code[i].m >= 0 && code[i].m < n )
+            procedures[code[i].m].calls += profile->instructionCounts[i];
+
+    qsort(procedures, n, sizeof(ProcedureCounts), compareProcedures);
+
+    fprintf(outp, "\n***Procedures***\n%12s %7s %12s %7s %10s  %s\n", "SELF", "SELF%", "TOTAL", "TOTAL%", "CALLS", "NAME");
+    for(int i = 0; i < n && procedures[i].inclusive > 0; i++)
+    {
+        fprintf(outp, "%12lld %6.2f%% %12lld %6.2f%% %10lld  %s (%d)\n",
+            procedures[i].self, percentage(procedures[i].self, profile->total),
+            procedures[i].inclusive, percentage(procedures[i].inclusive, profile->total),
+            procedures[i].calls, getProcedureName(profile, procedures[i].entry, name, sizeof(name)),
+            procedures[i].entry);
+    }
+
+    free(onPath);
+    free(procedures);
+
+    // Opcodes
+    int order[OPCODE_COUNT];
+    for(int op = 0; op < OPCODE_COUNT; op++) order[op] = op;
+
+    sortedCounts = profile->opcodeCounts;
+    qsort(order, OPCODE_COUNT, sizeof(int), compareByCount);
+
+    fprintf(outp, "\n***Opcodes***\n%12s %7s  %s\n", "COUNT", "%", "OP");
+    for(int i = 0; i < OPCODE_COUNT && profile->opcodeCounts[order[i]] > 0; i++)
+    {
+        fprintf(outp, "%12lld %6.2f%%  %s\n", profile->opcodeCounts[order[i]],
+            percentage(profile->opcodeCounts[order[i]], profile->total), getOpcodeName(order[i]));
+    }
+
+    // Hot instructions
+    int* lines = malloc(n * sizeof(int));
+    for(int i = 0; i < n; i++) lines[i] = i;
+
+    sortedCounts = profile->instructionCounts;
+    qsort(lines, n, sizeof(int), compareByCount);
+
+    fprintf(outp, "\n***Hot Instructions***\n%12s %7s %4s %9s %3s %3s %5s  %s\n", "COUNT", "%", "#", "OP", "R", "L", "M", "PROCEDURE");
+    for(int i = 0; i < HOT_INSTRUCTION_COUNT && i < profile->numberOfInstructions; i++)
+    {
+        int line = lines[i];
+        Instruction ins = code[line];
+
+        if(!profile->instructionCounts[line]) break;
+
+        fprintf(outp, "%12lld %6.2f%% %4d %9s %3d %3d %5d  %s\n",
+            profile->instructionCounts[line], percentage(profile->instructionCounts[line], profile->total),
+            line, getOpcodeName(ins.op), ins.r, ins.l, ins.m,
+            getProcedureName(profile, profile->owners[line], name, sizeof(name)));
+    }
+
+    free(lines);
+}
+
+/**
+ * Prints the folded stack of the given node, whose names from the root are
+ * in path, and the stacks of its subtree.
+ * */
+static void printFoldedSubtree(Profile* profile, int node, char* path, size_t length, FILE* outp)
+{
+    char name[MAX_PROCEDURE_NAME_LENGTH + 16];
+    CallNode* n = &profile->nodes[node];
+
+    const char* procedureName = getProcedureName(profile, n->entry, name, sizeof(name));
+    size_t extended = length + (length ? 1 : 0) + strlen(procedureName);
+
+    sprintf(path + length, "%s%s", length ? ";" : "", procedureName);
+
+    if(n->count) fprintf(outp, "%s %lld\n", path, n->count);
+
+    for(int child = n->firstChild; child >= 0; child = profile->nodes[child].nextSibling)
+        printFoldedSubtree(profile, child, path, extended, outp);
+
+    path[length] = '\0';
+}
+
+void printFoldedStacks(Profile* profile, FILE* outp)
+{
+    char* path = malloc(MAX_PROFILE_DEPTH * (MAX_PROCEDURE_NAME_LENGTH + 16) + 1);
+
+    path[0] = '\0';
+    printFoldedSubtree(profile, 0, path, 0, outp);
+
+    free(path);
+}
@@ -0,0 +1,57 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <stdio.h>
+#include "data.h"
+
+/**
+ * Execution counts collected while running the code on the virtual machine.
+ * */
+typedef struct Profile Profile;
+
+/**
+ * Creates an empty profile of the code with the given number of instructions.
+ * */
+Profile* createProfile(int numberOfInstructions);
+
+/**
+ * Deallocates the given profile.
+ * */
+void deleteProfile(Profile*);
+
+/**
+ * Reads the names of the procedures from a symbol side-file written by the
+ * code generator (code_generator.out -g). Lines of the form
+ *
+ *   proc <address> <name>
+ *
+ * name the procedure whose code starts at the given address. Other lines are
+ * ignored. Procedures without a name are reported by their address.
+ * */
+void readProcedureNames(Profile*, FILE* symbols);
+
+/**
+ * Records the execution of the given instruction, which is at the given
+ * address. Must be called before the instruction is executed.
+ *
+ * Procedures are delimited dynamically: a CAL or an LCAL enters the
+ * procedure at its target and a RTN or an LRTN leaves the innermost one. Instructions are counted
+ * for the procedure they are executed in.
+ * */
+void profileInstruction(Profile*, int line, Instruction ins);
+
+/**
+ * Prints the instruction count of each procedure, each opcode and the most
+ * executed instructions, sorted by count.
+ * */
+void printProfileReport(Profile*, Instruction* code, FILE* outp);
+
+/**
+ * Prints one line per distinct call stack, the names of the procedures on
+ * the stack from the outermost one separated by semicolons, followed by the
+ * number of instructions executed with that stack. This is the folded stack
+ * format read by flame graph tools.
+ * */
+void printFoldedStacks(Profile*, FILE* outp);
+
+#endif
@@ -0,0 +1,328 @@
+#include "verifier.h"
+#include <stdlib.h>
+
+/**
+ * Number of slots of the header of an activation record: the functional
+ * value, the static link, the dynamic link and the return address.
+ * */
+#define AR_HEADER_SIZE 4
+
+/**
+ * Number of register operands of the given opcode, which are stored in the
+ * fields R, L and M in that order. Returns -1 for an invalid opcode.
+ * */
+static int getRegisterOperandCount(int op)
+{
+    switch(op)
+    {
+        case RTN: case CAL: case INC: case JMP: case SIO_HALT:
+        case MOV3: case ADD3: case SUB3: case MUL3: case DIV3:
+        case JEQ3: case JNE3: case JLT3: case JLE3: case JGT3: case JGE3:
+            return 0;
+
+        case LIT: case LOD: case STO: case JPC:
+        case SIO_WRITE: case SIO_READ: case ODD:
+        case JEQI: case JNEI: case JLTI: case JLEI: case JGTI: case JGEI:
+        case LCAL: case LRTN:
+            return 1;
+
+        case NEG:
+        case JEQ: case JNE: case JLT: case JLE: case JGT: case JGE:
+        case ADDI: case SUBI: case MULI: case DIVI:
+            return 2;
+
+        case ADD: case SUB: case MUL: case DIV: case MOD:
+        case EQL: case NEQ: case LSS: case LEQ: case GTR: case GEQ:
+            return 3;
+
+        default:
+            return -1;
+    }
+}
+
+/**
+ * Number of the operands of the given three-address opcode, which are stored
+ * in the fields R, L and M in that order. Returns 0 for the other opcodes.
+ * */
+static int getThreeAddressOperandCount(int op)
+{
+    if(op == MOV3 || (op >= JEQ3 && op <= JGE3)) return 2;
+    if(op >= ADD3 && op <= DIV3) return 3;
+
+    return 0;
+}
+
+/**
+ * Returns the register that the given instruction writes to, or -1 if it
+ * writes to no register.
+ * */
+static int getWrittenRegister(Instruction ins)
+{
+    switch(ins.op)
+    {
+        case LIT: case LOD: case SIO_READ: case LCAL:
+        case NEG: case ADD: case SUB: case MUL: case DIV: case ODD: case MOD:
+        case EQL: case NEQ: case LSS: case LEQ: case GTR: case GEQ:
+        case ADDI: case SUBI: case MULI: case DIVI:
+            return ins.r;
+
+        case MOV3: case ADD3: case SUB3: case MUL3: case DIV3:
+            return OPERAND_KIND(ins.r) == OPERAND_REGISTER ? OPERAND_VALUE(ins.r) : -1;
+
+        default:
+            return -1;
+    }
+}
+
+/**
+ * Checks a single instruction regardless of the control flow.
+ * Returns the number of problems found.
+ * */
+static int verifyInstruction(Instruction* code, int numberOfInstructions, int i, FILE* err)
+{
+    Instruction ins = code[i];
+    int errors = 0;
+
+    int registerCount = getRegisterOperandCount(ins.op);
+    if(registerCount < 0)
+    {
+        if(err) fprintf(err, "Instruction %d: illegal op code %d\n", i, ins.op);
+        return 1;
+    }
+
+    int operands[3] = { ins.r, ins.l, ins.m };
+    for(int k = 0; k < registerCount; k++)
+    {
+        if(operands[k] < 0 || operands[k] >= REGISTER_FILE_REG_COUNT)
+        {
+            if(err) fprintf(err, "Instruction %d: register %d is out of the register file\n", i, operands[k]);
+            errors++;
+        }
+    }
+
+    // An operand is a register of the register file, a variable or a constant,
+    // which is not the destination of a three-address instruction
+    int operandCount = getThreeAddressOperandCount(ins.op);
+    for(int k = 0; k < operandCount; k++)
+    {
+        int kind = OPERAND_KIND(operands[k]), value = OPERAND_VALUE(operands[k]);
+
+        int valid = kind == OPERAND_CONSTANT ? k > 0 || ins.op >= JEQ3
+                  : kind == OPERAND_REGISTER ? value >= 0 && value < REGISTER_FILE_REG_COUNT
+                  : kind == OPERAND_VARIABLE && value >= 0 && value < MAX_FRAME_SIZE;
+
+        if(!valid)
+        {
+            if(err) fprintf(err, "Instruction %d: invalid operand %d\n", i, operands[k]);
+            errors++;
+        }
+        else if(k == 0 && ins.op <= DIV3 && kind == OPERAND_VARIABLE && value < AR_HEADER_SIZE)
+        {
+            if(err) fprintf(err, "Instruction %d: writes slot %d of the header of the activation record\n", i, value);
+            errors++;
+        }
+    }
+
+    if( (ins.op == LOD || ins.op == STO || ins.op == CAL) && ins.l < 0 )
+    {
+        if(err) fprintf(err, "Instruction %d: negative level %d\n", i, ins.l);
+        errors++;
+    }
+
+    if( (ins.op == LOD || ins.op == STO || ins.op == INC) && ins.m < 0 )
+    {
+        if(err) fprintf(err, "Instruction %d: negative offset %d\n", i, ins.m);
+        errors++;
+    }
+
+    // The links and the return address are only written by CAL
+    if( ins.op == STO && ins.m >= 0 && ins.m < AR_HEADER_SIZE )
+    {
+        if(err) fprintf(err, "Instruction %d: writes slot %d of the header of the activation record\n", i, ins.m);
+        errors++;
+    }
+
+    if( (ins.op == LOD || ins.op == STO) && ins.m >= MAX_FRAME_SIZE )
+    {
+        if(err) fprintf(err, "Instruction %d: offset %d is past the largest activation record\n", i, ins.m);
+        errors++;
+    }
+
+    int isBranch = ins.op == JMP || ins.op == JPC || ins.op == CAL || ins.op == LCAL || (ins.op >= JEQ && ins.op <= JGE) || (ins.op >= JEQI && ins.op <= JGEI)
+        || (ins.op >= JEQ3 && ins.op <= JGE3);
+
+    if( isBranch && (ins.m < 0 || ins.m >= numberOfInstructions) )
+    {
+        if(err) fprintf(err, "Instruction %d: target %d is out of the code memory\n", i, ins.m);
+        errors++;
+    }
+
+    return errors;
+}
+
+/**
+ * A point of the control flow to be visited: an instruction, the stack height
+ * and the static depth it is reached with, and the instruction it is reached
+ * from (-1 for entry points). Inside a procedure called by LCAL, link is the
+ * register holding the return address and linkHeight the stack height of the
+ * LCAL, otherwise link is -1.
+ * */
+typedef struct {
+    int pc, height, depth, from;
+    int link, linkHeight;
+} FlowState;
+
+int verifyInstructions(Instruction* code, int numberOfInstructions, FILE* err)
+{
+    int errors = 0;
+
+    for(int i = 0; i < numberOfInstructions; i++)
+        errors += verifyInstruction(code, numberOfInstructions, i, err);
+
+    // Control flow is only walked over well-formed instructions
+    if(errors || numberOfInstructions == 0)
+    {
+        if(!numberOfInstructions && err) fprintf(err, "Code memory is empty\n");
+        return errors + !numberOfInstructions;
+    }
+
+    int* heights = malloc(numberOfInstructions * sizeof(int));
+    int* depths = malloc(numberOfInstructions * sizeof(int));
+    int* links = malloc(numberOfInstructions * sizeof(int));
+
+    // Each instruction pushes at most two states, and is expanded only once
+    FlowState* worklist = malloc(2 * (numberOfInstructions + 1) * sizeof(FlowState));
+    int worklistSize = 0;
+
+    for(int i = 0; i < numberOfInstructions; i++)
+        heights[i] = depths[i] = -1;
+
+    worklist[worklistSize++] = (FlowState){ .pc = 0, .height = 0, .depth = 0, .from = -1, .link = -1 };
+
+    while(worklistSize > 0)
+    {
+        FlowState s = worklist[--worklistSize];
+
+        if(s.pc >= numberOfInstructions)
+        {
+            if(err) fprintf(err, "Instruction %d: execution falls off the end of the code memory\n", s.from);
+            errors++;
+            continue;
+        }
+
+        if(heights[s.pc] >= 0)
+        {
+            if(heights[s.pc] != s.height)
+            {
+                if(err) fprintf(err, "Instruction %d: reached with stack heights %d and %d\n", s.pc, heights[s.pc], s.height);
+                errors++;
+            }
+            if(depths[s.pc] != s.depth)
+            {
+                if(err) fprintf(err, "Instruction %d: reached at static depths %d and %d\n", s.pc, depths[s.pc], s.depth);
+                errors++;
+            }
+            if(links[s.pc] != s.link)
+            {
+                if(err) fprintf(err, "Instruction %d: reached with link registers %d and %d\n", s.pc, links[s.pc], s.link);
+                errors++;
+            }
+            continue;
+        }
+
+        heights[s.pc] = s.height;
+        depths[s.pc] = s.depth;
+        links[s.pc] = s.link;
+
+        Instruction ins = code[s.pc];
+
+        if( (ins.op == LOD || ins.op == STO || ins.op == CAL) && ins.l > s.depth )
+        {
+            if(err) fprintf(err, "Instruction %d: level %d exceeds static depth %d\n", s.pc, ins.l, s.depth);
+            errors++;
+            continue;
+        }
+
+        // The return address of a leaf call is kept until its LRTN
+        if( s.link >= 0 && (getWrittenRegister(ins) == s.link || ins.op == CAL) )
+        {
+            if(err) fprintf(err, "Instruction %d: overwrites the return address in register %d\n", s.pc, s.link);
+            errors++;
+            continue;
+        }
+
+        FlowState next = s;
+        next.pc = s.pc + 1;
+        next.from = s.pc;
+
+        switch(ins.op)
+        {
+            case RTN:
+            case SIO_HALT:
+                break;
+
+            case INC:
+                // CAL writes the header of the callee right above the record
+                next.height += ins.m;
+                if(next.height > MAX_FRAME_SIZE - AR_HEADER_SIZE)
+                {
+                    if(err) fprintf(err, "Instruction %d: activation record of %d slots is larger than %d\n", s.pc, next.height, MAX_FRAME_SIZE - AR_HEADER_SIZE);
+                    errors++;
+                    break;
+                }
+                worklist[worklistSize++] = next;
+                break;
+
+            case JMP:
+                next.pc = ins.m;
+                worklist[worklistSize++] = next;
+                break;
+
+            case JPC:
+            case JEQ: case JNE: case JLT: case JLE: case JGT: case JGE:
+            case JEQI: case JNEI: case JLTI: case JLEI: case JGTI: case JGEI:
+            case JEQ3: case JNE3: case JLT3: case JLE3: case JGT3: case JGE3:
+                worklist[worklistSize++] = next;
+                next.pc = ins.m;
+                worklist[worklistSize++] = next;
+                break;
+
+            case CAL:
+                // Execution continues after the call once the callee returns
+                worklist[worklistSize++] = next;
+
+                // The callee starts with an empty activation record
+                worklist[worklistSize++] = (FlowState){ .pc = ins.m, .height = 0, .depth = s.depth - ins.l + 1, .from = s.pc, .link = -1 };
+                break;
+
+            case LCAL:
+                worklist[worklistSize++] = next;
+
+                // The callee runs in the activation record of the caller
+                next.pc = ins.m;
+                next.link = ins.r;
+                next.linkHeight = s.height;
+                worklist[worklistSize++] = next;
+                break;
+
+            case LRTN:
+                if(ins.r != s.link || s.height != s.linkHeight)
+                {
+                    if(err) fprintf(err, "Instruction %d: LRTN does not return from a leaf call\n", s.pc);
+                    errors++;
+                }
+                break;
+
+            default:
+                worklist[worklistSize++] = next;
+                break;
+        }
+    }
+
+    free(worklist);
+    free(links);
+    free(depths);
+    free(heights);
+
+    return errors;
+}
@@ -0,0 +1,53 @@
+#ifndef __VERIFIER_H__
+#define __VERIFIER_H__
+
+#include <stdio.h>
+#include "data.h"
+
+/**
+ * Number of slots of the largest activation record that a verified program
+ * could address, counting the header that CAL writes above it. The guard of
+ * the virtual machine covers as many slots, see createVirtualMachine().
+ * */
+#define MAX_FRAME_SIZE 65536
+
+/**
+ * Verifies the given code before it is loaded to the virtual machine.
+ *
+ * Every instruction is checked for
+ *  - a valid opcode,
+ *  - register operands less than REGISTER_FILE_REG_COUNT,
+ *  - three-address operands that are registers, variables or constants,
+ *    with no constant destination,
+ *  - non-negative L and M operands,
+ *  - LOD, STO and three-address variable offsets less than MAX_FRAME_SIZE,
+ *  - no STO or three-address destination in the header of an activation
+ *    record, the first 4 slots, which only CAL writes,
+ *  - JMP, JPC, CAL, LCAL and compare and branch targets inside the code
+ *    memory.
+ *
+ * Starting from the first instruction and following CAL and LCAL targets,
+ * the control flow is walked to check that
+ *  - execution never falls off the end of the code memory,
+ *  - every instruction is reached with a single stack height relative to the
+ *    base pointer of its activation record, which never becomes negative
+ *    and leaves room for the header of a callee in MAX_FRAME_SIZE slots,
+ *  - every instruction is reached at a single static nesting depth, and no
+ *    LOD, STO or CAL follows more static links than that depth,
+ *  - every LRTN is reached from an LCAL, with its register and stack height,
+ *    and no instruction in between writes that register or is a CAL,
+ *  - every instruction is reached with a single such register, or none.
+ *
+ * A verified program never fetches an instruction outside the code memory,
+ * therefore it can be run without checking the program counter. Since no
+ * instruction writes the header of its own activation record, the links and
+ * the return address are those written by CAL. A STO that follows static
+ * links is not bounded by the record it lands in, however, so the
+ * interpreter still checks the program counter after RTN.
+ *
+ * Writes a message to err (if not NULL) for each problem and returns the
+ * number of problems found. Returns 0 if the code is verified.
+ * */
+int verifyInstructions(Instruction* code, int numberOfInstructions, FILE* err);
+
+#endif
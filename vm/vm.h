@@ -2,6 +2,7 @@
 #define __VM_H__
 
 #include <stdio.h>
+#include "data.h"
 
 /**
  * inp: The FILE pointer containing the list of instructions to
@@ -26,4 +27,32 @@ void simulateVM(
     FILE* vm_outp
 );
 
+/**
+ * The building blocks of simulateVM() that are also exported by vm.o.
+ * */
+
+/**
+ * Lower case names of the opcodes, indexed by opcode. "illegal" at index 0.
+ * */
+extern const char* opcodes[];
+
+/**
+ * Walks L static links starting from the base pointer BP and returns the
+ * base pointer of the activation record found.
+ * */
+int getBasePointer(int* stack, int BP, int L);
+
+/**
+ * Writes the activation records on the stack, starting from the given
+ * SP and BP, by separating them with "|".
+ * */
+void dumpStack(FILE* outp, int* stack, int SP, int BP);
+
+/**
+ * Executes a single instruction. The PC of vm should already point to the
+ * next instruction. Returns 1 if the instruction halts the machine, 0
+ * otherwise. Terminates the process on an illegal opcode.
+ * */
+int executeInstruction(VirtualMachine* vm, Instruction ins, FILE* vm_inp, FILE* vm_outp);
+
 #endif
\ No newline at end of file
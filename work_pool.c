@@ -0,0 +1,133 @@
+#include "work_pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * The jobs [front, back) that are not started yet by the owner of the queue
+ * or stolen by another worker.
+ * */
+typedef struct {
+    pthread_mutex_t lock;
+    int front;
+    int back;
+} WorkQueue;
+
+typedef struct {
+    WorkQueue* queues;
+    int numberOfQueues;
+    void (*job)(int, void*);
+    void* arg;
+} WorkPool;
+
+typedef struct {
+    WorkPool* pool;
+    int id;
+} Worker;
+
+/**
+ * Takes the next job from the front of the given queue.
+ * Returns -1 if the queue is empty.
+ * */
+static int takeFront(WorkQueue* queue)
+{
+    int index = -1;
+
+    pthread_mutex_lock(&queue->lock);
+    if(queue->front < queue->back) index = queue->front++;
+    pthread_mutex_unlock(&queue->lock);
+
+    return index;
+}
+
+/**
+ * Steals the last job from the back of the given queue.
+ * Returns -1 if the queue is empty.
+ * */
+static int takeBack(WorkQueue* queue)
+{
+    int index = -1;
+
+    pthread_mutex_lock(&queue->lock);
+    if(queue->front < queue->back) index = --queue->back;
+    pthread_mutex_unlock(&queue->lock);
+
+    return index;
+}
+
+static void* runWorker(void* arg)
+{
+    Worker* worker = arg;
+    WorkPool* pool = worker->pool;
+
+    while(1)
+    {
+        int index = takeFront(&pool->queues[worker->id]);
+
+        // Own queue is empty: steal from the others, starting from the next one
+        for(int k = 1; index < 0 && k < pool->numberOfQueues; k++)
+            index = takeBack(&pool->queues[(worker->id + k) % pool->numberOfQueues]);
+
+        /**
+         * Every queue is empty. Since jobs are never added, there is nothing
+         * left to wait for.
+         * */
+        if(index < 0) break;
+
+        pool->job(index, pool->arg);
+    }
+
+    return NULL;
+}
+
+void runWorkPool(int numberOfJobs, int numberOfThreads, void (*job)(int index, void* arg), void* arg)
+{
+    if(numberOfJobs <= 0) return;
+
+    if(numberOfThreads < 1) numberOfThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if(numberOfThreads < 1) numberOfThreads = 1;
+    if(numberOfThreads > numberOfJobs) numberOfThreads = numberOfJobs;
+
+    if(numberOfThreads == 1)
+    {
+        for(int i = 0; i < numberOfJobs; i++) job(i, arg);
+        return;
+    }
+
+    WorkPool pool = { .numberOfQueues = numberOfThreads, .job = job, .arg = arg };
+    pool.queues = malloc(numberOfThreads * sizeof(WorkQueue));
+
+    Worker* workers = malloc(numberOfThreads * sizeof(Worker));
+    pthread_t* threads = malloc(numberOfThreads * sizeof(pthread_t));
+    char* created = calloc(numberOfThreads, 1);
+
+    // Deal the jobs in contiguous chunks, which differ in size by at most one
+    for(int t = 0; t < numberOfThreads; t++)
+    {
+        pthread_mutex_init(&pool.queues[t].lock, NULL);
+        pool.queues[t].front = (int)((long long)numberOfJobs * t / numberOfThreads);
+        pool.queues[t].back = (int)((long long)numberOfJobs * (t + 1) / numberOfThreads);
+
+        workers[t] = (Worker){ .pool = &pool, .id = t };
+    }
+
+    /**
+     * The calling thread is the first worker. If a thread could not be
+     * created, the jobs of its queue are stolen by the others.
+     * */
+    for(int t = 1; t < numberOfThreads; t++)
+        created[t] = !pthread_create(&threads[t], NULL, runWorker, &workers[t]);
+
+    runWorker(&workers[0]);
+
+    for(int t = 1; t < numberOfThreads; t++)
+        if(created[t]) pthread_join(threads[t], NULL);
+
+    for(int t = 0; t < numberOfThreads; t++)
+        pthread_mutex_destroy(&pool.queues[t].lock);
+
+    free(created);
+    free(threads);
+    free(workers);
+    free(pool.queues);
+}
@@ -0,0 +1,18 @@
+#ifndef __WORK_POOL_H__
+#define __WORK_POOL_H__
+
+/**
+ * Runs job(i, arg) for every i in [0, numberOfJobs) on numberOfThreads worker
+ * threads and returns once all of them are done.
+ *
+ * Jobs are dealt to the workers in contiguous chunks. A worker runs the jobs
+ * of its own chunk from the front, and once it runs out of them, steals jobs
+ * from the back of the chunk of another worker. Therefore, a few long jobs do
+ * not keep the other workers idle.
+ *
+ * If numberOfThreads is less than 1, the number of online processors is used.
+ * Jobs are run on the calling thread if a single worker is needed.
+ * */
+void runWorkPool(int numberOfJobs, int numberOfThreads, void (*job)(int index, void* arg), void* arg);
+
+#endif